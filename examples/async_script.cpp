@@ -0,0 +1,120 @@
+#include <utility>
+
+#include <jsapi.h>
+#include <js/CompilationAndEvaluation.h>
+#include <js/SourceText.h>
+
+#include "async_script.h"
+
+// Compiling a large script (a multi-megabyte bundle, for example) can take long
+// enough to noticeably block an embedding's event loop if it happens inside
+// JS::Evaluate(). SpiderMonkey can instead parse a script on one of its helper
+// threads, producing a JS::Stencil, while the calling thread does other work.
+// Only instantiating the stencil and running it has to happen on the context's
+// own thread, once parsing is done.
+//
+// AsyncScript::Start() begins compiling and returns a handle. The caller can
+// keep servicing its event loop, and check isDone() or wait() with a timeout,
+// for example:
+//
+//   auto script = boilerplate::AsyncScript::Start(cx, options, code);
+//   if (!script) return false;
+//   while (!script->wait(std::chrono::milliseconds(5))) js::RunJobs(cx);
+//   if (!script->finish(&rval)) return false;
+//
+// finish() must be called on the context's thread, in the realm where the
+// script should run. It blocks if parsing isn't done yet. Scripts that are too
+// small for SpiderMonkey to bother with helper threads are compiled right away
+// in Start(), and are done immediately.
+
+boilerplate::AsyncScript::AsyncScript(JSContext* cx, std::string code)
+    : m_cx(cx),
+      m_options(cx),
+      m_code(std::move(code)),
+      m_token(nullptr),
+      m_done(false) {}
+
+boilerplate::AsyncScript::~AsyncScript() { cancel(); }
+
+// Begin compiling 'code'. The returned handle owns the source text, which must
+// stay alive while it's being parsed. Returns null with an exception pending if
+// compilation could not be started.
+std::unique_ptr<boilerplate::AsyncScript> boilerplate::AsyncScript::Start(
+    JSContext* cx, const JS::ReadOnlyCompileOptions& options,
+    std::string code) {
+  std::unique_ptr<AsyncScript> script(new AsyncScript(cx, std::move(code)));
+
+  // The options must outlive the call, since the helper thread uses them.
+  if (!script->m_options.copy(cx, options)) return nullptr;
+
+  JS::SourceText<mozilla::Utf8Unit> source;
+  if (!source.init(cx, script->m_code.data(), script->m_code.length(),
+                   JS::SourceOwnership::Borrowed)) {
+    return nullptr;
+  }
+
+  if (JS::CanCompileOffThread(cx, script->m_options, script->m_code.length())) {
+    script->m_token = JS::CompileToStencilOffThread(
+        cx, script->m_options, source, &AsyncScript::OnCompiled, script.get());
+    if (!script->m_token) return nullptr;
+    return script;
+  }
+
+  script->m_stencil =
+      JS::CompileGlobalScriptToStencil(cx, script->m_options, source);
+  if (!script->m_stencil) return nullptr;
+  script->m_done = true;
+  return script;
+}
+
+// Called on the helper thread when parsing has finished, successfully or not.
+// The result is collected by FinishOffThreadStencil() in finish().
+void boilerplate::AsyncScript::OnCompiled(JS::OffThreadToken* token,
+                                          void* data) {
+  auto* script = static_cast<AsyncScript*>(data);
+  {
+    std::lock_guard<std::mutex> guard(script->m_lock);
+    script->m_done = true;
+  }
+  script->m_compiled.notify_all();
+}
+
+bool boilerplate::AsyncScript::isDone() {
+  std::lock_guard<std::mutex> guard(m_lock);
+  return m_done;
+}
+
+// Wait up to 'timeout' for parsing to finish. Returns whether it has.
+bool boilerplate::AsyncScript::wait(std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> guard(m_lock);
+  return m_compiled.wait_for(guard, timeout, [this] { return m_done; });
+}
+
+// Instantiate the compiled script in the current global and run it. This can
+// only be done once.
+bool boilerplate::AsyncScript::finish(JS::MutableHandleValue rval) {
+  RefPtr<JS::Stencil> stencil = std::move(m_stencil);
+  if (m_token) {
+    stencil = JS::FinishOffThreadStencil(m_cx, std::exchange(m_token, nullptr));
+    if (!stencil) return false;
+  }
+
+  if (!stencil) {
+    JS_ReportErrorASCII(m_cx, "AsyncScript was already finished or cancelled");
+    return false;
+  }
+
+  JS::InstantiateOptions instantiateOptions(m_options);
+  JS::RootedScript script(
+      m_cx, JS::InstantiateGlobalStencil(m_cx, instantiateOptions, stencil));
+  if (!script) return false;
+
+  return JS_ExecuteScript(m_cx, script, rval);
+}
+
+// Abandon the script. If it is still being parsed, this waits for the helper
+// thread to stop working on it.
+void boilerplate::AsyncScript::cancel() {
+  if (m_token) JS::CancelOffThreadToken(m_cx, std::exchange(m_token, nullptr));
+  m_stencil = nullptr;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <jsapi.h>
+#include <js/CompileOptions.h>
+#include <js/OffThreadScriptCompilation.h>
+#include <js/experimental/JSStencil.h>
+#include <mozilla/RefPtr.h>
+
+// See 'async_script.cpp' for documentation.
+
+namespace boilerplate {
+
+class AsyncScript {
+ public:
+  static std::unique_ptr<AsyncScript> Start(
+      JSContext* cx, const JS::ReadOnlyCompileOptions& options,
+      std::string code);
+
+  ~AsyncScript();
+
+  AsyncScript(const AsyncScript&) = delete;
+  AsyncScript& operator=(const AsyncScript&) = delete;
+
+  bool isDone();
+  bool wait(std::chrono::milliseconds timeout);
+
+  bool finish(JS::MutableHandleValue rval);
+  void cancel();
+
+ private:
+  AsyncScript(JSContext* cx, std::string code);
+
+  static void OnCompiled(JS::OffThreadToken* token, void* data);
+
+  JSContext* m_cx;
+  JS::OwningCompileOptions m_options;
+  std::string m_code;
+
+  // Set when compiling on a helper thread, until finish() or cancel().
+  JS::OffThreadToken* m_token;
+  // Set when the script was small enough to compile on the calling thread.
+  RefPtr<JS::Stencil> m_stencil;
+
+  std::mutex m_lock;
+  std::condition_variable m_compiled;
+  bool m_done : 1;
+};
+
+}  // namespace boilerplate
@@ -0,0 +1,1352 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include <unistd.h>
+
+#include <jsapi.h>
+#include <js/Array.h>
+#include <js/CallArgs.h>
+#include <js/CompilationAndEvaluation.h>
+#include <js/Conversions.h>
+#include <js/ErrorReport.h>
+#include <js/Exception.h>
+#include <js/GCVector.h>
+#include <js/Initialization.h>
+#include <js/Object.h>
+#include <js/PropertySpec.h>
+#include <js/SourceText.h>
+
+#include "async_script.h"
+#include "boilerplate.h"
+#include "callable.h"
+#include "content_hash.h"
+#include "context_pool.h"
+#include "cookbook_classes.h"
+#include "error_policy.h"
+#include "exception_log.h"
+#include "gc_stats.h"
+#include "json_stream.h"
+#include "memory_report.h"
+#include "native_binding.h"
+#include "property_keys.h"
+#include "realm_pool.h"
+#include "script_cache.h"
+#include "script_file.h"
+#include "string_bridge.h"
+#include "struct_marshal.h"
+#include "watchdog.h"
+
+// This program measures the cost of the facilities in 'boilerplate.cpp' and
+// friends, so that changes to them (or SpiderMonkey upgrades) can be compared.
+//
+// Each measurement is printed to stdout as one JSON object per line, so the
+// output can be collected by a script:
+//
+//   {"suite": "pool", "case": "lease", "iterations": 1000, "ns_per_op": 1234,
+//    "allocs_per_op": 2.0, "minor_gcs": 0, "major_gcs": 0}
+//
+// allocs_per_op counts calls to malloc(), calloc() and realloc() from any
+// thread, which is only available with glibc; elsewhere it is always 0. The GC
+// counts are those of the main benchmark context, for the timed iterations.
+//
+// Pass suite names on the command line to run only those suites.
+
+using Clock = std::chrono::steady_clock;
+
+static std::atomic<uint64_t> s_allocations{0};
+
+#ifdef __GLIBC__
+// Count heap allocations by interposing the allocation functions and
+// forwarding to glibc's own implementations.
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size) {
+  s_allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+  s_allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+  s_allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+}
+#endif  // __GLIBC__
+
+// The context that the benchmarks run on, for reading its GC counters.
+static JSContext* s_cx = nullptr;
+
+struct Counters {
+  Clock::time_point time;
+  uint64_t allocations;
+  uint32_t minorGCs;
+  uint32_t majorGCs;
+
+  static Counters Now() {
+    return {Clock::now(), s_allocations.load(std::memory_order_relaxed),
+            JS_GetGCParameter(s_cx, JSGC_MINOR_GC_NUMBER),
+            JS_GetGCParameter(s_cx, JSGC_MAJOR_GC_NUMBER)};
+  }
+};
+
+static void Report(const char* suite, const char* name, size_t iterations,
+                   const Counters& start, const Counters& end) {
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      end.time - start.time);
+  printf(
+      "{\"suite\": \"%s\", \"case\": \"%s\", \"iterations\": %zu, "
+      "\"ns_per_op\": %.1f, \"allocs_per_op\": %.1f, \"minor_gcs\": %u, "
+      "\"major_gcs\": %u}\n",
+      suite, name, iterations, double(ns.count()) / iterations,
+      double(end.allocations - start.allocations) / iterations,
+      end.minorGCs - start.minorGCs, end.majorGCs - start.majorGCs);
+  fflush(stdout);
+}
+
+// Run 'op' a few times untimed to warm up caches and the JIT, then time
+// 'iterations' runs of it.
+template <typename Op>
+static bool Measure(const char* suite, const char* name, size_t iterations,
+                    Op&& op) {
+  for (size_t i = 0; i < iterations / 10 + 1; i++) {
+    if (!op()) return false;
+  }
+
+  Counters start = Counters::Now();
+  for (size_t i = 0; i < iterations; i++) {
+    if (!op()) return false;
+  }
+  Report(suite, name, iterations, start, Counters::Now());
+  return true;
+}
+
+// Compile 'code' as a global script, with 'filename' for error messages.
+static JSScript* CompileSource(JSContext* cx, const char* filename,
+                               std::string_view code) {
+  JS::CompileOptions options(cx);
+  options.setFileAndLine(filename, 1);
+
+  JS::SourceText<mozilla::Utf8Unit> source;
+  if (!source.init(cx, code.data(), code.length(),
+                   JS::SourceOwnership::Borrowed)) {
+    return nullptr;
+  }
+
+  return JS::Compile(cx, options, source);
+}
+
+// Compile and run 'code' as a global script.
+static bool EvaluateSource(JSContext* cx, const char* filename,
+                           std::string_view code, JS::MutableHandleValue rval) {
+  JS::CompileOptions options(cx);
+  options.setFileAndLine(filename, 1);
+
+  JS::SourceText<mozilla::Utf8Unit> source;
+  if (!source.init(cx, code.data(), code.length(),
+                   JS::SourceOwnership::Borrowed)) {
+    return false;
+  }
+
+  return JS::Evaluate(cx, options, source, rval);
+}
+
+static bool EvaluateTrivialScript(JSContext* cx) {
+  JS::RootedValue rval(cx);
+  return EvaluateSource(cx, "bench", "1 + 1", &rval);
+}
+
+///// Cookbook recipes ///////////////////////////////////////////////////////
+
+// The basic JSAPI operations from 'cookbook.cpp', one per case, to track the
+// overhead of each call across SpiderMonkey versions. The classes and the
+// Person constructor are the cookbook's own, from 'cookbook_classes.cpp'.
+
+static bool DefineCookbookFixtures(JSContext* cx, JS::HandleObject global) {
+  static const char code[] = R"js(
+    function foo() { return 1; }
+    var point = {x: 1, y: 2};
+    var myObj = new MyClass(1, 2);
+  )js";
+
+  // Shared with the jitinfo suite, so only define them once.
+  bool defined;
+  if (!JS_HasProperty(cx, global, "myObj", &defined)) return false;
+  if (defined) return true;
+
+  if (!JS_DefineFunction(cx, global, "Person", cookbook::PersonConstructor, 2,
+                         JSFUN_CONSTRUCTOR) ||
+      !cookbook::DefineMyClass(cx, global)) {
+    return false;
+  }
+
+  JS::RootedValue rval(cx);
+  return EvaluateSource(cx, "cookbook.js", code, &rval);
+}
+
+static bool GetGlobalObject(JSContext* cx, JS::HandleObject global,
+                            const char* name, JS::MutableHandleObject obj) {
+  JS::RootedValue v(cx);
+  if (!JS_GetProperty(cx, global, name, &v)) return false;
+  if (!v.isObject()) {
+    JS_ReportErrorASCII(cx, "%s is not an object", name);
+    return false;
+  }
+  obj.set(&v.toObject());
+  return true;
+}
+
+static bool CookbookSuite(JSContext* cx) {
+  JS::RootedObject global(cx, JS::CurrentGlobalOrNull(cx));
+  JS::RootedObject point(cx), person(cx), myObj(cx);
+  if (!DefineCookbookFixtures(cx, global) ||
+      !GetGlobalObject(cx, global, "point", &point) ||
+      !GetGlobalObject(cx, global, "Person", &person) ||
+      !GetGlobalObject(cx, global, "myObj", &myObj)) {
+    return false;
+  }
+
+  constexpr size_t N = 100000;
+
+  bool ok =
+      Measure("cookbook", "get_property", N,
+              [cx, &point] {
+                JS::RootedValue v(cx);
+                return JS_GetProperty(cx, point, "x", &v);
+              }) &&
+      Measure("cookbook", "set_property", N,
+              [cx, &point] {
+                JS::RootedValue v(cx, JS::Int32Value(3));
+                return JS_SetProperty(cx, point, "y", v);
+              }) &&
+      Measure("cookbook", "construct_person", N,
+              [cx, &person] {
+                JS::RootedString name(cx, JS_NewStringCopyZ(cx, "Dave"));
+                if (!name) return false;
+                JS::RootedValueArray<2> args(cx);
+                args[0].setString(name);
+                args[1].setInt32(24);
+                JS::RootedValue ctor(cx, JS::ObjectValue(*person));
+                JS::RootedObject obj(cx);
+                return JS::Construct(cx, ctor, args, &obj);
+              }) &&
+      Measure("cookbook", "call_function_name", N,
+              [cx, &global] {
+                JS::RootedValue r(cx);
+                return JS_CallFunctionName(cx, global, "foo",
+                                           JS::HandleValueArray::empty(), &r);
+              }) &&
+      Measure("cookbook", "new_array_object", N,
+              [cx] { return !!JS::NewArrayObject(cx, 10); }) &&
+      Measure("cookbook", "throw_and_catch_value", N,
+              [cx] {
+                JS::RootedValue exc(cx, JS::Int32Value(42));
+                JS_SetPendingException(cx, exc);
+                JS::RootedValue caught(cx);
+                if (!JS_GetPendingException(cx, &caught)) return false;
+                JS_ClearPendingException(cx);
+                return true;
+              }) &&
+      Measure("cookbook", "myclass_getter", N,
+              [cx, &myObj] {
+                JS::RootedValue v(cx);
+                return JS_GetProperty(cx, myObj, "prop", &v);
+              }) &&
+      Measure("cookbook", "myclass_method", N, [cx, &myObj] {
+        JS::RootedValue r(cx);
+        return JS_CallFunctionName(cx, myObj, "method",
+                                   JS::HandleValueArray::empty(), &r);
+      });
+
+  return ok;
+}
+
+///// JIT-inlinable natives //////////////////////////////////////////////////
+
+// The getter and method of the cookbook's MyClass, which are plain JSNatives,
+// and of its MyJitClass, which are annotated with JSJitInfo, called in a hot
+// loop of 10000 iterations per operation.
+
+static bool MeasureHotLoop(JSContext* cx, const char* name, const char* obj) {
+  std::string code = std::string("var s = 0;\n") +
+                     "for (let i = 0; i < 10000; i++) s += " + obj +
+                     ".prop + " + obj + ".method();\n";
+
+  JS::RootedScript script(cx, CompileSource(cx, "jitinfo.js", code));
+  if (!script) return false;
+
+  return Measure("jitinfo", name, 200, [cx, &script] {
+    JS::RootedValue rval(cx);
+    return JS_ExecuteScript(cx, script, &rval);
+  });
+}
+
+static bool JitInfoSuite(JSContext* cx) {
+  JS::RootedObject global(cx, JS::CurrentGlobalOrNull(cx));
+  if (!DefineCookbookFixtures(cx, global)) return false;
+
+  if (!cookbook::DefineMyJitClass(cx, global)) return false;
+
+  JS::RootedValue rval(cx);
+  if (!EvaluateSource(cx, "jitinfo.js", "var myJitObj = new MyJitClass(1, 2);",
+                      &rval)) {
+    return false;
+  }
+
+  return MeasureHotLoop(cx, "plain_native_x10000", "myObj") &&
+         MeasureHotLoop(cx, "jitinfo_native_x10000", "myJitObj");
+}
+
+///// Native classes ///////////////////////////////////////////////////////////
+
+// Creating and using many small instances of the cookbook's MyClass (a and b
+// in reserved slots), MyJitClass (a struct allocated with new) and
+// MyNativeClass (a struct from a pool, with generated accessors).
+
+static bool MeasureInstances(JSContext* cx, const char* name,
+                             const char* className) {
+  std::string code = std::string("var s = 0;\n") +
+                     "for (let i = 0; i < 10000; i++) s += new " + className +
+                     "(i, 1).method();\n";
+
+  JS::RootedScript script(cx, CompileSource(cx, "classes.js", code));
+  if (!script) return false;
+
+  return Measure("classes", name, 100, [cx, &script] {
+    JS::RootedValue rval(cx);
+    return JS_ExecuteScript(cx, script, &rval);
+  });
+}
+
+static bool ClassesSuite(JSContext* cx) {
+  JS::RootedObject global(cx, JS::CurrentGlobalOrNull(cx));
+  bool defined;
+  if (!DefineCookbookFixtures(cx, global) ||
+      !JS_HasProperty(cx, global, "MyJitClass", &defined)) {
+    return false;
+  }
+
+  if (!defined && !cookbook::DefineMyJitClass(cx, global)) return false;
+
+  if (!cookbook::DefineMyNativeClass(cx, global)) return false;
+
+  return MeasureInstances(cx, "reserved_slots_x10000", "MyClass") &&
+         MeasureInstances(cx, "new_struct_x10000", "MyJitClass") &&
+         MeasureInstances(cx, "native_class_x10000", "MyNativeClass");
+}
+
+///// Context startup ////////////////////////////////////////////////////////
+
+// What boilerplate::RunExample() does for every task, minus JS_Init() and
+// JS_ShutDown() which may only happen once per process. It needs its own
+// thread, since there can only be one JSContext per thread.
+static bool ColdStartTask(bool (*initSelfHosting)(JSContext*)) {
+  bool ok = false;
+  std::thread thread([&ok, initSelfHosting] {
+    JSContext* cx = JS_NewContext(JS::DefaultHeapMaxBytes);
+    if (!cx) return;
+
+    if (initSelfHosting(cx)) {
+      JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+      if (global) {
+        JSAutoRealm ar(cx, global);
+        ok = EvaluateTrivialScript(cx);
+      }
+    }
+
+    JS_DestroyContext(cx);
+  });
+  thread.join();
+  return ok;
+}
+
+static bool UncachedInitSelfHostedCode(JSContext* cx) {
+  return JS::InitSelfHostedCode(cx);
+}
+
+static bool StartupSuite(JSContext* cx) {
+  if (!Measure("startup", "self_hosted_uncached", 20, [] {
+        return ColdStartTask(UncachedInitSelfHostedCode);
+      })) {
+    return false;
+  }
+
+  return Measure("startup", "self_hosted_cached", 20, [] {
+    return ColdStartTask(boilerplate::InitSelfHostedCode);
+  });
+}
+
+///// Context pool /////////////////////////////////////////////////////////////
+
+static bool PoolSuite(JSContext* cx) {
+  if (!Measure("pool", "run_example", 20, [] {
+        return ColdStartTask(boilerplate::InitSelfHostedCode);
+      })) {
+    return false;
+  }
+
+  boilerplate::ContextPool pool(JS_GetRuntime(cx), 2);
+  if (!pool.init()) return false;
+
+  return Measure("pool", "lease", 1000, [&pool] {
+    return pool.run([](JSContext* cx, JS::HandleObject global) {
+      return EvaluateTrivialScript(cx);
+    });
+  });
+}
+
+///// Sharing compiled scripts between realms ////////////////////////////////
+
+// A stand-in for a tenant bootstrap script: a few hundred small functions and
+// some top-level code that calls them.
+static std::string MakeBootstrapScript(int functions = 300) {
+  std::string code;
+  for (int i = 0; i < functions; i++) {
+    std::string n = std::to_string(i);
+    code += "function helper" + n + "(a, b) {\n";
+    code += "  const o = {x: a, y: b, tag: 'helper" + n + "'};\n";
+    code += "  return o.x * " + n + " + o.y;\n";
+    code += "}\n";
+  }
+  code += "var total = 0;\n";
+  code += "for (let i = 0; i < 300; i += 30) total += helper0(i, 1);\n";
+  return code;
+}
+
+// Create a new realm and run the bootstrap script in it, either compiling it
+// from scratch or instantiating the shared stencil.
+static bool BootstrapRealm(JSContext* cx, const std::string& code,
+                           boilerplate::StencilCache* cache) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+
+  JSAutoRealm ar(cx, global);
+
+  JS::RootedValue rval(cx);
+  if (!cache) return EvaluateSource(cx, "bootstrap.js", code, &rval);
+
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("bootstrap.js", 1);
+
+  JS::SourceText<mozilla::Utf8Unit> source;
+  if (!source.init(cx, code.c_str(), code.length(),
+                   JS::SourceOwnership::Borrowed)) {
+    return false;
+  }
+
+  return cache->evaluate(cx, options, source, &rval);
+}
+
+static bool RealmsSuite(JSContext* cx) {
+  std::string code = MakeBootstrapScript();
+
+  if (!Measure("realms", "bootstrap_compile_each", 200, [cx, &code] {
+        return BootstrapRealm(cx, code, nullptr);
+      })) {
+    return false;
+  }
+
+  boilerplate::StencilCache cache(16);
+  return Measure("realms", "bootstrap_shared_stencil", 200,
+                 [cx, &code, &cache] {
+                   return BootstrapRealm(cx, code, &cache);
+                 });
+}
+
+///// Per-request realms ///////////////////////////////////////////////////
+
+static const char requestHandler[] = R"js(
+  var request = {path: '/items/42', query: {limit: 10}};
+  var items = [];
+  for (let i = 0; i < request.query.limit; i++) items.push({id: i});
+  JSON.stringify({path: request.path, items});
+)js";
+
+// Run one request in its own global.
+static bool HandleRequest(JSContext* cx, JS::HandleObject global) {
+  JSAutoRealm ar(cx, global);
+
+  JS::RootedValue rval(cx);
+  return EvaluateSource(cx, "handler.js", requestHandler, &rval);
+}
+
+// Requests/sec is 1e9 / ns_per_op. The "_latency" cases only time the request
+// itself, as if maintain() ran while the server was idle; the other counters
+// cover the whole loop.
+static bool MeasureRealmPool(JSContext* cx, const char* name,
+                             boilerplate::RealmPool::Placement placement) {
+  boilerplate::RealmPool::Options options;
+  options.placement = placement;
+  boilerplate::RealmPool pool(cx, options);
+  if (!pool.init()) return false;
+
+  auto request = [cx, &pool] {
+    JS::RootedObject global(cx, pool.acquire());
+    if (!global || !HandleRequest(cx, global)) return false;
+    pool.release(global);
+    return true;
+  };
+  auto maintain = [&pool] {
+    return pool.maintain(boilerplate::RealmPool::Clock::duration::max());
+  };
+
+  if (!Measure("realmpool", name, 1000,
+               [&request, &maintain] { return request() && maintain(); })) {
+    return false;
+  }
+
+  Clock::duration busy{};
+  size_t iterations = 1000;
+  Counters start = Counters::Now();
+  for (size_t i = 0; i < iterations; i++) {
+    Clock::time_point begin = Clock::now();
+    if (!request()) return false;
+    busy += Clock::now() - begin;
+
+    if (!maintain()) return false;
+  }
+  Counters end = Counters::Now();
+  end.time = start.time + busy;
+  Report("realmpool", (std::string(name) + "_latency").c_str(), iterations,
+         start, end);
+  return true;
+}
+
+static bool RealmPoolSuite(JSContext* cx) {
+  if (!Measure("realmpool", "create_each", 1000, [cx] {
+        JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+        return global && HandleRequest(cx, global);
+      })) {
+    return false;
+  }
+
+  using Placement = boilerplate::RealmPool::Placement;
+  return MeasureRealmPool(cx, "pool_new_zone", Placement::NewZone) &&
+         MeasureRealmPool(cx, "pool_shared_zone", Placement::SharedZone) &&
+         MeasureRealmPool(cx, "pool_shared_compartment",
+                          Placement::SharedCompartment);
+}
+
+///// Off-thread compilation /////////////////////////////////////////////////
+
+// How long the calling thread is blocked when running a large (~1.5 MB) script,
+// compiling it synchronously or on a helper thread. With AsyncScript, only
+// starting the compilation and instantiating the result block the caller.
+static bool AsyncSuite(JSContext* cx) {
+  std::string code = MakeBootstrapScript(15000);
+
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("bundle.js", 1);
+
+  if (!Measure("async", "evaluate_blocked", 10, [cx, &code] {
+        JS::RootedValue rval(cx);
+        return EvaluateSource(cx, "bundle.js", code, &rval);
+      })) {
+    return false;
+  }
+
+  // Only the blocked time is reported, while the other counters cover the
+  // whole loop.
+  Clock::duration blocked{};
+  size_t iterations = 10;
+  Counters start = Counters::Now();
+  for (size_t i = 0; i < iterations; i++) {
+    Clock::time_point begin = Clock::now();
+    auto script = boilerplate::AsyncScript::Start(cx, options, code);
+    if (!script) return false;
+    blocked += Clock::now() - begin;
+
+    // The event loop would run here.
+    while (!script->wait(std::chrono::milliseconds(1))) {
+    }
+
+    begin = Clock::now();
+    JS::RootedValue rval(cx);
+    if (!script->finish(&rval)) return false;
+    blocked += Clock::now() - begin;
+  }
+  Counters end = Counters::Now();
+  end.time = start.time + blocked;
+  Report("async", "offthread_blocked", iterations, start, end);
+  return true;
+}
+
+///// Loading scripts from files /////////////////////////////////////////////
+
+// Read the whole file into a string, as an embedding would do without the
+// mmap-based loader.
+static bool ReadFileContents(const char* path, std::string* contents) {
+  FILE* fp = fopen(path, "rb");
+  if (!fp) return false;
+
+  char chunk[65536];
+  size_t nread;
+  contents->clear();
+  while ((nread = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+    contents->append(chunk, nread);
+  }
+
+  bool ok = !ferror(fp);
+  fclose(fp);
+  return ok;
+}
+
+static bool EvaluateCopiedFile(JSContext* cx, const char* path) {
+  std::string code;
+  if (!ReadFileContents(path, &code)) return false;
+
+  JS::RootedValue rval(cx);
+  return EvaluateSource(cx, path, code, &rval);
+}
+
+static bool FilesSuite(JSContext* cx) {
+  char path[] = "/tmp/bench-bundle-XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) return false;
+
+  std::string code = MakeBootstrapScript(15000);
+  bool ok = write(fd, code.data(), code.length()) == ssize_t(code.length());
+  close(fd);
+
+  ok = ok && Measure("files", "read_and_evaluate", 10,
+                     [cx, &path] { return EvaluateCopiedFile(cx, path); });
+  ok = ok && Measure("files", "mapped_copied_source", 10, [cx, &path] {
+         JS::RootedValue rval(cx);
+         return boilerplate::EvaluateFile(cx, path, &rval,
+                                          boilerplate::FileSource::Copy);
+       });
+  // No lazy parsing: every function is compiled up front.
+  ok = ok && Measure("files", "mapped_lazy_source", 10, [cx, &path] {
+         JS::RootedValue rval(cx);
+         return boilerplate::EvaluateFile(cx, path, &rval,
+                                          boilerplate::FileSource::Mapped);
+       });
+
+  unlink(path);
+  return ok;
+}
+
+///// Large JSON documents /////////////////////////////////////////////////
+
+// Build a document of 'count' records, about 85 bytes of JSON each.
+static bool MakeJSONDocument(JSContext* cx, uint32_t count, const char* label,
+                             JS::MutableHandleValue doc) {
+  static const char code[] = R"js(
+    (function (count, label) {
+      const records = [];
+      for (let i = 0; i < count; i++) {
+        records.push({id: i, name: label + i, tags: ['alpha', 'beta'],
+                      price: i * 0.25, active: i % 2 == 0});
+      }
+      return {records};
+    })
+  )js";
+
+  JS::RootedValue make(cx);
+  if (!EvaluateSource(cx, "document.js", code, &make)) return false;
+
+  JS::RootedString labelStr(
+      cx, JS_NewStringCopyUTF8Z(cx, JS::ConstUTF8CharsZ(label, strlen(label))));
+  if (!labelStr) return false;
+
+  JS::RootedValueArray<2> args(cx);
+  args[0].setNumber(count);
+  args[1].setString(labelStr);
+  return JS_CallFunctionValue(cx, nullptr, make, args, doc);
+}
+
+// Write a document to a temporary file, returning false if it failed.
+static bool WriteJSONFile(JSContext* cx, JS::HandleValue doc, char* path,
+                          size_t* size) {
+  int fd = mkstemp(path);
+  if (fd < 0) return false;
+
+  boilerplate::ChunkedBuffer buffer;
+  bool ok = boilerplate::StringifyJSON(cx, doc, &buffer) &&
+            buffer.writeTo(fd);
+  close(fd);
+  *size = buffer.size();
+  return ok;
+}
+
+static bool MeasureParse(JSContext* cx, const char* suffix, const char* path) {
+  std::string name = std::string("parse_read_copy") + suffix;
+  if (!Measure("json", name.c_str(), 3, [cx, path] {
+        std::string text;
+        if (!ReadFileContents(path, &text)) return false;
+        JS::UTF8Chars chars(text.data(), text.length());
+        JS::RootedString str(cx, JS_NewStringCopyUTF8N(cx, chars));
+        JS::RootedValue v(cx);
+        return str && JS_ParseJSON(cx, str, &v);
+      })) {
+    return false;
+  }
+
+  name = std::string("parse_mapped") + suffix;
+  return Measure("json", name.c_str(), 3, [cx, path] {
+    JS::RootedValue v(cx);
+    return boilerplate::ParseJSONFile(cx, path, &v);
+  });
+}
+
+// The JSON.stringify() and JSON.parse() a native would do through script,
+// with the copies that come with it, against the streaming bridge. Throughput
+// in MB/s is the document size from stderr divided by ns_per_op, times 1000.
+static bool JSONSuite(JSContext* cx) {
+  // The documents are well over the default GC heap limit.
+  uint32_t maxBytes = JS_GetGCParameter(cx, JSGC_MAX_BYTES);
+  JS_SetGCParameter(cx, JSGC_MAX_BYTES, 0xffffffff);
+
+  FILE* devnull = fopen("/dev/null", "w");
+  if (!devnull) return false;
+  int devnullFd = fileno(devnull);
+
+  JS::RootedValue doc(cx);
+  bool ok = MakeJSONDocument(cx, 1200000, "item ", &doc);
+
+  JS::RootedObject global(cx, JS::CurrentGlobalOrNull(cx));
+  JS::RootedObject json(cx);
+  ok = ok && GetGlobalObject(cx, global, "JSON", &json);
+
+  ok = ok && Measure("json", "stringify_materialize", 3, [&] {
+         JS::RootedValue v(cx);
+         if (!JS_CallFunctionName(cx, json, "stringify",
+                                  JS::HandleValueArray(doc), &v)) {
+           return false;
+         }
+         JS::RootedString str(cx, v.toString());
+         JS::UniqueChars chars = JS_EncodeStringToUTF8(cx, str);
+         if (!chars) return false;
+         return write(devnullFd, chars.get(), strlen(chars.get())) >= 0;
+       });
+  ok = ok && Measure("json", "stringify_to_fd", 3, [cx, &doc, devnullFd] {
+         return boilerplate::StringifyJSONToFile(cx, doc, devnullFd);
+       });
+  boilerplate::ChunkedBuffer buffer;
+  ok = ok && Measure("json", "stringify_chunked_buffer", 3,
+                     [cx, &doc, &buffer] {
+                       buffer.clear();
+                       return boilerplate::StringifyJSON(cx, doc, &buffer);
+                     });
+  fclose(devnull);
+
+  char asciiPath[] = "/tmp/bench-json-XXXXXX";
+  size_t size = 0;
+  ok = ok && WriteJSONFile(cx, doc, asciiPath, &size);
+  if (ok) fprintf(stderr, "json: document is %zu bytes\n", size);
+  doc.setUndefined();
+  ok = ok && MeasureParse(cx, "", asciiPath);
+  unlink(asciiPath);
+
+  // Not ASCII, so it can't be parsed in place.
+  char utf8Path[] = "/tmp/bench-json-XXXXXX";
+  ok = ok && MakeJSONDocument(cx, 1200000, "artículo ", &doc) &&
+       WriteJSONFile(cx, doc, utf8Path, &size);
+  doc.setUndefined();
+  ok = ok && MeasureParse(cx, "_utf8", utf8Path);
+  unlink(utf8Path);
+
+  JS_SetGCParameter(cx, JSGC_MAX_BYTES, maxBytes);
+  return ok;
+}
+
+///// Exception capture //////////////////////////////////////////////////////
+
+static bool DefineThrower(JSContext* cx) {
+  static const char code[] = R"js(
+    function validate(x) { throw new Error(`invalid value ${x}`); }
+    function thrower() { return validate(42); }
+  )js";
+
+  JS::RootedValue rval(cx);
+  return EvaluateSource(cx, "exceptions.js", code, &rval);
+}
+
+// Call thrower(), which is expected to fail with an exception pending.
+static bool CallThrower(JSContext* cx) {
+  JS::RootedObject global(cx, JS::CurrentGlobalOrNull(cx));
+  JS::RootedValue rval(cx);
+  if (JS_CallFunctionName(cx, global, "thrower",
+                          JS::HandleValueArray::empty(), &rval)) {
+    return false;
+  }
+  return JS_IsExceptionPending(cx);
+}
+
+// A native that fails validation 50 frames deep, caught in script. The stack
+// capture dominates, so compare the error policies from 'error_policy.cpp'.
+static bool FailValidation(JSContext* cx, unsigned argc, JS::Value* vp) {
+  return boilerplate::ThrowError(cx, "invalid value", __FILE__, __LINE__);
+}
+
+static bool MeasureStackPolicy(JSContext* cx, const char* name,
+                               const boilerplate::ErrorPolicy& policy) {
+  boilerplate::ErrorPolicy saved = boilerplate::GetErrorPolicy();
+  boilerplate::SetErrorPolicy(policy);
+
+  JS::RootedObject global(cx, JS::CurrentGlobalOrNull(cx));
+  bool ok = Measure("exceptions", name, 10000, [cx, &global] {
+    JS::RootedValue rval(cx);
+    return JS_CallFunctionName(cx, global, "deepThrower",
+                               JS::HandleValueArray::empty(), &rval) &&
+           rval.isObject();
+  });
+
+  boilerplate::SetErrorPolicy(saved);
+  return ok;
+}
+
+static bool StackPolicySuite(JSContext* cx) {
+  static const char code[] = R"js(
+    function deep(n) { return n ? deep(n - 1) : failValidation(); }
+    function deepThrower() { try { deep(50); } catch (e) { return e; } }
+  )js";
+
+  JS::RootedObject global(cx, JS::CurrentGlobalOrNull(cx));
+  if (!JS_DefineFunction(cx, global, "failValidation", FailValidation, 0, 0)) {
+    return false;
+  }
+
+  JS::RootedValue rval(cx);
+  if (!EvaluateSource(cx, "exceptions.js", code, &rval)) return false;
+
+  boilerplate::ErrorPolicy fullStack;
+  boilerplate::ErrorPolicy maxFrames;
+  maxFrames.maxFrames = 8;
+  boilerplate::ErrorPolicy noStack;
+  noStack.maxFrames = 0;
+  boilerplate::ErrorPolicy sampled;
+  sampled.maxFrames = 8;
+  sampled.fullStackInterval = 100;
+
+  return MeasureStackPolicy(cx, "throw_error_full_stack", fullStack) &&
+         MeasureStackPolicy(cx, "throw_error_8_frames", maxFrames) &&
+         MeasureStackPolicy(cx, "throw_error_no_stack", noStack) &&
+         MeasureStackPolicy(cx, "throw_error_sampled_full_stack", sampled);
+}
+
+static bool ExceptionsSuite(JSContext* cx) {
+  FILE* devnull = fopen("/dev/null", "w");
+  if (!devnull) return false;
+
+  // What boilerplate::ReportAndClearException() does, minus exiting.
+  bool ok = DefineThrower(cx) &&
+            Measure("exceptions", "error_report_builder", 10000, [cx, devnull] {
+              if (!CallThrower(cx)) return false;
+              JS::ExceptionStack stack(cx);
+              if (!JS::StealPendingExceptionStack(cx, &stack)) return false;
+              JS::ErrorReportBuilder report(cx);
+              if (!report.init(cx, stack,
+                               JS::ErrorReportBuilder::WithSideEffects)) {
+                return false;
+              }
+              JS::PrintError(devnull, report, false);
+              return true;
+            });
+
+  if (ok) {
+    boilerplate::ExceptionLog log(1024, devnull);
+    ok = Measure("exceptions", "exception_log", 10000, [cx, &log] {
+      return CallThrower(cx) && log.capture(cx);
+    });
+  }
+
+  fclose(devnull);
+  return ok && StackPolicySuite(cx);
+}
+
+///// Generated natives /////////////////////////////////////////////////////
+
+// Hand-written JSNatives compared with the same functions bound through
+// 'native_binding.h', called from a script loop of 1000 calls per operation.
+
+static bool HandWrittenScale(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  int32_t a;
+  double b;
+  if (!JS::ToInt32(cx, args.get(0), &a) || !JS::ToNumber(cx, args.get(1), &b)) {
+    return false;
+  }
+  args.rval().setNumber(a * b);
+  return true;
+}
+
+static bool HandWrittenLength(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  JS::RootedString str(cx, JS::ToString(cx, args.get(0)));
+  if (!str) return false;
+  JS::UniqueChars chars = JS_EncodeStringToUTF8(cx, str);
+  if (!chars) return false;
+  args.rval().setInt32(int32_t(strlen(chars.get())));
+  return true;
+}
+
+static double GeneratedScale(int32_t a, double b) { return a * b; }
+
+static int32_t GeneratedLength(std::string_view s) {
+  return int32_t(s.length());
+}
+
+static JSFunctionSpec nativeBenchFunctions[] = {
+    JS_FN("handScale", HandWrittenScale, 2, 0),
+    JS_FN("handLength", HandWrittenLength, 1, 0),
+    boilerplate::FunctionSpec<GeneratedScale>("genScale", 0),
+    boilerplate::FunctionSpec<GeneratedLength>("genLength", 0),
+    JS_FS_END};
+
+static bool MeasureCallLoop(JSContext* cx, const char* name,
+                            const char* call) {
+  std::string code =
+      std::string("for (let i = 0; i < 1000; i++) ") + call + ";\n";
+
+  JS::RootedScript script(cx, CompileSource(cx, "natives.js", code));
+  if (!script) return false;
+
+  return Measure("natives", name, 1000, [cx, &script] {
+    JS::RootedValue rval(cx);
+    return JS_ExecuteScript(cx, script, &rval);
+  });
+}
+
+static bool NativesSuite(JSContext* cx) {
+  JS::RootedObject global(cx, JS::CurrentGlobalOrNull(cx));
+  if (!JS_DefineFunctions(cx, global, nativeBenchFunctions)) return false;
+
+  return MeasureCallLoop(cx, "handwritten_numbers_x1000",
+                         "handScale(i, 0.5)") &&
+         MeasureCallLoop(cx, "generated_numbers_x1000", "genScale(i, 0.5)") &&
+         MeasureCallLoop(cx, "handwritten_string_x1000",
+                         "handLength('hello')") &&
+         MeasureCallLoop(cx, "generated_string_x1000", "genLength('hello')");
+}
+
+///// Calling script callbacks ///////////////////////////////////////////////
+
+// Calling a global script function from C++ by name, and through a Callable
+// from 'callable.h', with and without checking whether it was rebound.
+static bool CallableSuite(JSContext* cx) {
+  static const char code[] = "function add(a, b) { return a + b; }";
+
+  JS::RootedObject global(cx, JS::CurrentGlobalOrNull(cx));
+  JS::RootedValue rval(cx);
+  if (!EvaluateSource(cx, "callable.js", code, &rval)) return false;
+
+  constexpr size_t N = 100000;
+
+  if (!Measure("callable", "call_function_name", N, [cx, &global] {
+        JS::RootedValueArray<2> args(cx);
+        args[0].setInt32(1);
+        args[1].setInt32(2);
+        JS::RootedValue r(cx);
+        double result;
+        return JS_CallFunctionName(cx, global, "add", args, &r) &&
+               JS::ToNumber(cx, r, &result);
+      })) {
+    return false;
+  }
+
+  boilerplate::Callable<double(int32_t, int32_t)> add;
+  if (!add.init(cx, global, "add")) return false;
+
+  if (!Measure("callable", "callable_checked", N, [cx, &add] {
+        double result;
+        return add.call(cx, 1, 2, &result);
+      })) {
+    return false;
+  }
+
+  add.setCheckBinding(false);
+  return Measure("callable", "callable_unchecked", N, [cx, &add] {
+    double result;
+    return add.call(cx, 1, 2, &result);
+  });
+}
+
+///// Execution budgets ///////////////////////////////////////////////////////
+
+// The cost of running a script under a budget from 'watchdog.h', and how long
+// a runaway script keeps running past a 1 ms budget before it is stopped.
+static bool WatchdogSuite(JSContext* cx) {
+  boilerplate::Watchdog watchdog;
+  if (!watchdog.addContext(cx)) return false;
+
+  JS::RootedScript runaway(cx,
+                           CompileSource(cx, "watchdog.js", "for (;;) {}"));
+  if (!runaway) return false;
+
+  bool ok =
+      Measure("watchdog", "budget_start_end", 100000,
+              [cx, &watchdog] {
+                boilerplate::AutoBudget budget(watchdog, cx,
+                                               std::chrono::seconds(1));
+                return true;
+              }) &&
+      Measure("watchdog", "trivial_script_no_budget", 10000,
+              [cx] { return EvaluateTrivialScript(cx); }) &&
+      Measure("watchdog", "trivial_script_with_budget", 10000,
+              [cx, &watchdog] {
+                boilerplate::AutoBudget budget(watchdog, cx,
+                                               std::chrono::seconds(1));
+                return EvaluateTrivialScript(cx);
+              }) &&
+      Measure("watchdog", "runaway_script_1ms_budget", 50,
+              [cx, &watchdog, &runaway] {
+                boilerplate::AutoBudget budget(watchdog, cx,
+                                               std::chrono::milliseconds(1));
+                JS::RootedValue rval(cx);
+                return !JS_ExecuteScript(cx, runaway, &rval) && budget.end();
+              });
+
+  watchdog.removeContext(cx);
+  return ok;
+}
+
+///// Pre-atomized property keys //////////////////////////////////////////////
+
+// Looking up global properties from C++ by C string, which atomizes the name
+// every time, and by a key from 'property_keys.h'.
+static bool KeysSuite(JSContext* cx) {
+  JS::RootedObject global(cx, JS::CurrentGlobalOrNull(cx));
+  if (!DefineCookbookFixtures(cx, global) ||
+      !boilerplate::InitPropertyKeys(cx)) {
+    return false;
+  }
+
+  constexpr size_t N = 100000;
+
+  return Measure("keys", "get_by_name", N,
+                 [cx, &global] {
+                   JS::RootedValue v(cx);
+                   return JS_GetProperty(cx, global, "Person", &v) &&
+                          JS_GetProperty(cx, global, "String", &v);
+                 }) &&
+         Measure("keys", "get_by_pinned_key", N, [cx, &global] {
+           JS::RootedValue v(cx);
+           return boilerplate::GetProperty(cx, global,
+                                           boilerplate::Key::Person, &v) &&
+                  boilerplate::GetProperty(cx, global,
+                                           boilerplate::Key::String, &v);
+         });
+}
+
+///// Struct marshalling //////////////////////////////////////////////////////
+
+// Converting C++ records to JS objects and back, one property at a time by
+// name, and with a StructMarshaller.
+
+namespace {
+struct Record {
+  int32_t id;
+  double score;
+  bool active;
+  std::string name;
+  std::string region;
+};
+}  // namespace
+
+static bool RecordToJSByName(JSContext* cx, const Record& record,
+                             JS::MutableHandleValue rval) {
+  JS::RootedObject obj(cx, JS_NewPlainObject(cx));
+  if (!obj) return false;
+
+  JS::RootedValue v(cx, JS::Int32Value(record.id));
+  if (!JS_SetProperty(cx, obj, "id", v)) return false;
+  v.setNumber(record.score);
+  if (!JS_SetProperty(cx, obj, "score", v)) return false;
+  v.setBoolean(record.active);
+  if (!JS_SetProperty(cx, obj, "active", v)) return false;
+  JSString* str = JS_NewStringCopyN(cx, record.name.data(), record.name.size());
+  if (!str) return false;
+  v.setString(str);
+  if (!JS_SetProperty(cx, obj, "name", v)) return false;
+  str = JS_NewStringCopyN(cx, record.region.data(), record.region.size());
+  if (!str) return false;
+  v.setString(str);
+  if (!JS_SetProperty(cx, obj, "region", v)) return false;
+
+  rval.setObject(*obj);
+  return true;
+}
+
+static bool RecordFromJSByName(JSContext* cx, JS::HandleObject obj,
+                               Record* record) {
+  JS::RootedValue v(cx);
+  if (!JS_GetProperty(cx, obj, "id", &v) ||
+      !JS::ToInt32(cx, v, &record->id) ||
+      !JS_GetProperty(cx, obj, "score", &v) ||
+      !JS::ToNumber(cx, v, &record->score) ||
+      !JS_GetProperty(cx, obj, "active", &v)) {
+    return false;
+  }
+  record->active = JS::ToBoolean(v);
+
+  for (auto [name, field] : {std::pair("name", &record->name),
+                             std::pair("region", &record->region)}) {
+    if (!JS_GetProperty(cx, obj, name, &v)) return false;
+    JS::RootedString str(cx, JS::ToString(cx, v));
+    if (!str) return false;
+    JS::UniqueChars chars = JS_EncodeStringToUTF8(cx, str);
+    if (!chars) return false;
+    field->assign(chars.get());
+  }
+  return true;
+}
+
+static bool MarshalSuite(JSContext* cx) {
+  boilerplate::StructMarshaller records(
+      boilerplate::Field("id", &Record::id),
+      boilerplate::Field("score", &Record::score),
+      boilerplate::Field("active", &Record::active),
+      boilerplate::Field("name", &Record::name),
+      boilerplate::Field("region", &Record::region));
+  if (!records.init(cx)) return false;
+
+  Record record{42, 0.75, true, "widget", "eu-west"};
+  constexpr size_t N = 100000;
+
+  JS::RootedValue v(cx);
+  if (!Measure("marshal", "to_js_by_name", N,
+               [cx, &record, &v] {
+                 return RecordToJSByName(cx, record, &v);
+               }) ||
+      !Measure("marshal", "to_js_marshaller", N, [cx, &records, &record, &v] {
+        return records.toJS(cx, record, &v);
+      })) {
+    return false;
+  }
+
+  JS::RootedObject obj(cx, &v.toObject());
+  Record out;
+  return Measure("marshal", "from_js_by_name", N,
+                 [cx, &obj, &out] {
+                   return RecordFromJSByName(cx, obj, &out);
+                 }) &&
+         Measure("marshal", "from_js_marshaller", N,
+                 [cx, &records, &obj, &out] {
+                   return records.fromJS(cx, obj, &out);
+                 });
+}
+
+///// Strings between C++ and JS ///////////////////////////////////////////////
+
+// Returning a constant string to JS by copying, as an external string, and as
+// an interned atom; and converting a JS string to UTF-8 with a fresh
+// allocation and into a reused buffer.
+static bool StringsSuite(JSContext* cx) {
+  constexpr size_t N = 100000;
+
+  if (!Measure("strings", "constant_copy", N,
+               [cx] {
+                 return !!JS_NewStringCopyZ(
+                     cx, "d41d8cd98f00b204e9800998ecf8427e");
+               }) ||
+      !Measure("strings", "constant_external", N,
+               [cx] {
+                 return !!boilerplate::NewStaticString(
+                     cx, u"d41d8cd98f00b204e9800998ecf8427e");
+               }) ||
+      !Measure("strings", "constant_interned", N, [cx] {
+        return !!boilerplate::InternString(cx,
+                                           "d41d8cd98f00b204e9800998ecf8427e");
+      })) {
+    return false;
+  }
+
+  std::string text(200, 'x');
+  JS::RootedString str(cx, JS_NewStringCopyN(cx, text.data(), text.size()));
+  if (!str) return false;
+
+  return Measure("strings", "encode_utf8_alloc", N,
+                 [cx, &str] {
+                   JS::UniqueChars chars = JS_EncodeStringToUTF8(cx, str);
+                   return !!chars;
+                 }) &&
+         Measure("strings", "encode_utf8_reused", N, [cx, &str] {
+           std::string_view chars;
+           return boilerplate::EncodeUTF8(cx, str, &chars);
+         });
+}
+
+///// Content hashing //////////////////////////////////////////////////////////
+
+// Hashing 64 KiB of Latin-1 text, two-byte text and binary data with each
+// algorithm, and an interned string whose digest is memoized.
+static bool HashingSuite(JSContext* cx) {
+  constexpr size_t N = 200;
+  constexpr size_t Size = 64 * 1024;
+
+  std::string latin1(Size, 'x');
+  JS::RootedString latin1Str(cx, JS_NewStringCopyN(cx, latin1.data(), Size));
+  std::u16string twoByte(Size, u'\u00e9');
+  JS::RootedString twoByteStr(cx,
+                              JS_NewUCStringCopyN(cx, twoByte.data(), Size));
+  if (!latin1Str || !twoByteStr) return false;
+
+  struct {
+    const char* name;
+    boilerplate::HashAlgorithm algorithm;
+  } algorithms[] = {{"md5", boilerplate::HashAlgorithm::MD5},
+                    {"sha256", boilerplate::HashAlgorithm::SHA256},
+                    {"xxh64", boilerplate::HashAlgorithm::XXH64}};
+
+  for (const auto& [name, algorithm] : algorithms) {
+    std::string prefix = name;
+    boilerplate::HexDigest digest;
+    if (!Measure("hashing", (prefix + "_latin1_64k").c_str(), N,
+                 [cx, &latin1Str, algorithm = algorithm, &digest] {
+                   return boilerplate::HashString(cx, latin1Str, algorithm,
+                                                  &digest);
+                 }) ||
+        !Measure("hashing", (prefix + "_twobyte_64k").c_str(), N,
+                 [cx, &twoByteStr, algorithm = algorithm, &digest] {
+                   return boilerplate::HashString(cx, twoByteStr, algorithm,
+                                                  &digest);
+                 }) ||
+        !Measure("hashing", (prefix + "_bytes_64k").c_str(), N,
+                 [&latin1, algorithm = algorithm, &digest] {
+                   digest = boilerplate::HashBytes(
+                       algorithm,
+                       reinterpret_cast<const uint8_t*>(latin1.data()), Size);
+                   return digest.length > 0;
+                 })) {
+      return false;
+    }
+  }
+
+  JS::RootedString interned(
+      cx, boilerplate::InternString(cx, "d41d8cd98f00b204e9800998ecf8427e"));
+  if (!interned) return false;
+
+  boilerplate::HexDigest digest;
+  return Measure("hashing", "sha256_interned_memoized", 100000,
+                 [cx, &interned, &digest] {
+                   return boilerplate::HashString(
+                       cx, interned, boilerplate::HashAlgorithm::SHA256,
+                       &digest);
+                 });
+}
+
+///// Memory reports /////////////////////////////////////////////////////////
+
+// The cost of taking a memory report on a heap with a few dozen realms, each
+// loaded with the bootstrap script, as an embedding would when sampling.
+static bool MemorySuite(JSContext* cx) {
+  std::string code = MakeBootstrapScript();
+
+  JS::RootedVector<JSObject*> globals(cx);
+  for (int i = 0; i < 50; i++) {
+    JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+    if (!global || !globals.append(global)) return false;
+
+    JSAutoRealm ar(cx, global);
+    JS::RootedValue rval(cx);
+    if (!EvaluateSource(cx, "bootstrap.js", code, &rval)) return false;
+  }
+
+  boilerplate::MemoryReport report;
+  if (!Measure("memory", "collect_50_realms", 20,
+               [cx, &report] { return report.collect(cx); })) {
+    return false;
+  }
+
+  std::string json;
+  return Measure("memory", "to_json_50_realms", 200, [&report, &json] {
+    json = report.toJSON();
+    return !json.empty();
+  });
+}
+
+/**** BOILERPLATE *************************************************************/
+
+struct Suite {
+  const char* name;
+  bool (*run)(JSContext* cx);
+};
+
+static const Suite suites[] = {
+    {"cookbook", CookbookSuite},
+    {"jitinfo", JitInfoSuite},
+    {"classes", ClassesSuite},
+    {"startup", StartupSuite},
+    {"pool", PoolSuite},
+    {"realms", RealmsSuite},
+    {"realmpool", RealmPoolSuite},
+    {"async", AsyncSuite},
+    {"files", FilesSuite},
+    {"json", JSONSuite},
+    {"exceptions", ExceptionsSuite},
+    {"keys", KeysSuite},
+    {"marshal", MarshalSuite},
+    {"memory", MemorySuite},
+    {"strings", StringsSuite},
+    {"hashing", HashingSuite},
+    {"natives", NativesSuite},
+    {"callable", CallableSuite},
+    {"watchdog", WatchdogSuite},
+};
+
+static int s_argc;
+static const char** s_argv;
+
+static bool ShouldRun(const char* name) {
+  if (s_argc < 2) return true;
+  for (int i = 1; i < s_argc; i++) {
+    if (strcmp(s_argv[i], name) == 0) return true;
+  }
+  return false;
+}
+
+static bool RunBenchmarks(JSContext* cx) {
+  s_cx = cx;
+
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+
+  JSAutoRealm ar(cx, global);
+
+  // GC activity and error stack captures during the benchmarks are summarized
+  // on stderr at the end.
+  if (!boilerplate::EnableGCStats(cx)) return false;
+
+  bool ok = true;
+  for (const Suite& suite : suites) {
+    if (!ShouldRun(suite.name)) continue;
+    if (!suite.run(cx)) {
+      fprintf(stderr, "Error: benchmark suite '%s' failed\n", suite.name);
+      ok = false;
+      break;
+    }
+  }
+
+  boilerplate::GetGCStats(cx)->print(stderr);
+  boilerplate::GetErrorStats()->print(stderr);
+  boilerplate::DisableGCStats(cx);
+
+  // The context is destroyed after this.
+  boilerplate::ResetPropertyKeys(cx);
+  boilerplate::ResetStringCaches(cx);
+  boilerplate::ResetContentHashing(cx);
+  return ok;
+}
+
+int main(int argc, const char* argv[]) {
+  s_argc = argc;
+  s_argv = argv;
+  if (!boilerplate::RunExample(RunBenchmarks)) {
+    return 1;
+  }
+  return 0;
+}
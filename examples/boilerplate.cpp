@@ -1,7 +1,20 @@
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include <jsapi.h>
 
 #include <js/Initialization.h>
 #include <js/Exception.h>
+#include <js/GCAPI.h>
+
+#include <unistd.h>
 
 #include "boilerplate.h"
 
@@ -11,8 +24,13 @@
 // Create a simple Global object. A global object is the top-level 'this' value
 // in a script and is required in order to compile or execute JavaScript.
 JSObject* boilerplate::CreateGlobal(JSContext* cx) {
-  JS::RealmOptions options;
+  return CreateGlobal(cx, JS::RealmOptions());
+}
 
+// The same, with options for the new realm; for example, to create it in an
+// existing zone or compartment (see 'realm_pool.cpp').
+JSObject* boilerplate::CreateGlobal(JSContext* cx,
+                                    const JS::RealmOptions& options) {
   static JSClass BoilerplateGlobalClass = {
       "BoilerplateGlobal", JSCLASS_GLOBAL_FLAGS, &JS::DefaultGlobalClassOps};
 
@@ -39,22 +57,325 @@ void boilerplate::ReportAndClearException(JSContext* cx) {
   JS::PrintError(stderr, report, false);
 }
 
+// Initialize the self-hosted code (the parts of the standard library that are
+// written in JavaScript) for a new context, sharing the work between contexts.
+//
+// JS::InitSelfHostedCode() compiles the self-hosted code from scratch for each
+// top-level context. Instead, the first call here asks SpiderMonkey for the
+// compiled result in serialized form and keeps it for the rest of the process;
+// later contexts only need to deserialize it. This only helps separate
+// top-level runtimes, such as the ones in a context pool: contexts created
+// with a parent runtime already share the parent's copy, so they should keep
+// calling JS::InitSelfHostedCode() (see 'worker.cpp').
+//
+// The cache file is written to a unique temporary file with mkstemp() and
+// renamed into place, so that processes starting at the same time never read
+// a partially written file, or write over each other's temporary file.
+//
+// If the BOILERPLATE_SELF_HOSTED_CACHE environment variable names a file, the
+// serialized code is also saved there and loaded at startup by later
+// processes. The file is tagged with the SpiderMonkey version, and ignored if
+// it doesn't match. Delete it if SpiderMonkey is rebuilt with other options.
+//
+// NOTE: SpiderMonkey uses the cache buffer without copying, so it is never
+// modified or freed once it has been handed out.
+static std::mutex selfHostedCacheLock;
+static std::vector<uint8_t> selfHostedCache;
+
+static bool ReadSelfHostedCacheFile(const char* path) {
+  FILE* fp = fopen(path, "rb");
+  if (!fp) return false;
+
+  const char* version = JS_GetImplementationVersion();
+  std::vector<char> tag(strlen(version) + 1);
+  bool ok = fread(tag.data(), 1, tag.size(), fp) == tag.size() &&
+            memcmp(tag.data(), version, tag.size()) == 0;
+
+  std::vector<uint8_t> contents;
+  uint8_t chunk[65536];
+  size_t nread;
+  while (ok && (nread = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+    contents.insert(contents.end(), chunk, chunk + nread);
+  }
+  ok = ok && !ferror(fp) && !contents.empty();
+
+  fclose(fp);
+  if (ok) selfHostedCache = std::move(contents);
+  return ok;
+}
+
+static void WriteSelfHostedCacheFile(const char* path) {
+  std::string tmpPath = std::string(path) + ".XXXXXX";
+  int fd = mkstemp(tmpPath.data());
+  if (fd < 0) return;
+  FILE* fp = fdopen(fd, "wb");
+  if (!fp) {
+    close(fd);
+    remove(tmpPath.c_str());
+    return;
+  }
+
+  const char* version = JS_GetImplementationVersion();
+  bool ok = fwrite(version, 1, strlen(version) + 1, fp) ==
+                strlen(version) + 1 &&
+            fwrite(selfHostedCache.data(), 1, selfHostedCache.size(), fp) ==
+                selfHostedCache.size();
+  ok = fclose(fp) == 0 && ok;
+
+  if (!ok || rename(tmpPath.c_str(), path) != 0) {
+    fprintf(stderr, "Warning: could not write self-hosted cache '%s'\n", path);
+    remove(tmpPath.c_str());
+  }
+}
+
+// Called by SpiderMonkey with the freshly compiled self-hosted code, while
+// selfHostedCacheLock is held.
+static bool SaveSelfHostedCache(JSContext* cx, JS::SelfHostedCache buffer) {
+  selfHostedCache.assign(buffer.begin(), buffer.end());
+
+  if (const char* path = getenv("BOILERPLATE_SELF_HOSTED_CACHE")) {
+    WriteSelfHostedCacheFile(path);
+  }
+  return true;
+}
+
+bool boilerplate::InitSelfHostedCode(JSContext* cx) {
+  {
+    std::lock_guard<std::mutex> guard(selfHostedCacheLock);
+
+    if (selfHostedCache.empty()) {
+      const char* path = getenv("BOILERPLATE_SELF_HOSTED_CACHE");
+      if (!path || !ReadSelfHostedCacheFile(path)) {
+        // Compile from scratch. Other threads wait for us instead of doing the
+        // same work in parallel.
+        return JS::InitSelfHostedCode(cx, nullptr, SaveSelfHostedCache);
+      }
+    }
+  }
+
+  return JS::InitSelfHostedCode(cx, JS::SelfHostedCache(selfHostedCache));
+}
+
+// Runtime and GC tuning, so that an embedding can trade throughput against
+// pause times per deployment without recompiling. Settings that are left unset
+// keep SpiderMonkey's defaults.
+//
+// Settings can be read from a file with one "key = value" pair per line
+// ('#' starts a comment), and from environment variables: the file named by
+// BOILERPLATE_RUNTIME_CONFIG is read first, then each key can be overridden by
+// a variable named BOILERPLATE_ followed by the key in upper case, for example
+// BOILERPLATE_MAX_NURSERY_BYTES=16M. Byte sizes accept K, M and G suffixes.
+namespace {
+struct RuntimeConfigKey {
+  const char* name;
+  std::optional<uint32_t> boilerplate::RuntimeConfig::*field;
+};
+}  // namespace
+
+static const RuntimeConfigKey runtimeConfigKeys[] = {
+    {"max_heap_bytes", &boilerplate::RuntimeConfig::maxHeapBytes},
+    {"min_nursery_bytes", &boilerplate::RuntimeConfig::minNurseryBytes},
+    {"max_nursery_bytes", &boilerplate::RuntimeConfig::maxNurseryBytes},
+    {"slice_budget_ms", &boilerplate::RuntimeConfig::sliceBudgetMs},
+    {"incremental_gc", &boilerplate::RuntimeConfig::incrementalGC},
+    {"per_zone_gc", &boilerplate::RuntimeConfig::perZoneGC},
+    {"baseline_interpreter_warmup",
+     &boilerplate::RuntimeConfig::baselineInterpreterWarmup},
+    {"baseline_warmup", &boilerplate::RuntimeConfig::baselineWarmup},
+    {"ion_warmup", &boilerplate::RuntimeConfig::ionWarmup},
+};
+
+static bool ParseConfigValue(const char* value, uint32_t* out) {
+  while (isspace(*value)) value++;
+  // strtoull() would accept a sign, and wrap negative numbers around.
+  if (!isdigit(*value)) return false;
+
+  char* end;
+  errno = 0;
+  unsigned long long number = strtoull(value, &end, 10);
+  if (errno == ERANGE) return false;
+
+  unsigned long long multiplier = 1;
+  switch (toupper(*end)) {
+    case 'G':
+      multiplier = 1024 * 1024 * 1024;
+      end++;
+      break;
+    case 'M':
+      multiplier = 1024 * 1024;
+      end++;
+      break;
+    case 'K':
+      multiplier = 1024;
+      end++;
+      break;
+  }
+  if (number > ULLONG_MAX / multiplier) return false;
+  number *= multiplier;
+
+  while (isspace(*end)) end++;
+  if (*end != '\0' || number > UINT32_MAX) return false;
+
+  *out = uint32_t(number);
+  return true;
+}
+
+// Set one setting by name. Returns false if the key or value is not valid.
+bool boilerplate::RuntimeConfig::set(const char* key, const char* value) {
+  for (const RuntimeConfigKey& entry : runtimeConfigKeys) {
+    if (strcmp(entry.name, key) != 0) continue;
+
+    uint32_t number;
+    if (!ParseConfigValue(value, &number)) {
+      fprintf(stderr, "Error: invalid value '%s' for runtime setting '%s'\n",
+              value, key);
+      return false;
+    }
+    this->*entry.field = number;
+    return true;
+  }
+
+  fprintf(stderr, "Error: unknown runtime setting '%s'\n", key);
+  return false;
+}
+
+bool boilerplate::RuntimeConfig::loadFile(const char* path) {
+  FILE* fp = fopen(path, "r");
+  if (!fp) {
+    fprintf(stderr, "Error: could not open runtime config '%s'\n", path);
+    return false;
+  }
+
+  bool ok = true;
+  char line[256];
+  while (ok && fgets(line, sizeof(line), fp)) {
+    if (char* comment = strchr(line, '#')) *comment = '\0';
+
+    const char* text = line + strspn(line, " \t\r\n");
+    if (*text == '\0') continue;
+
+    char key[64];
+    char value[64];
+    if (sscanf(text, "%63[a-z_] = %63s", key, value) != 2) {
+      fprintf(stderr, "Error: malformed line in runtime config '%s': %s\n",
+              path, line);
+      ok = false;
+      break;
+    }
+    ok = set(key, value);
+  }
+
+  fclose(fp);
+  return ok;
+}
+
+bool boilerplate::RuntimeConfig::loadEnvironment() {
+  if (const char* path = getenv("BOILERPLATE_RUNTIME_CONFIG")) {
+    if (!loadFile(path)) return false;
+  }
+
+  for (const RuntimeConfigKey& entry : runtimeConfigKeys) {
+    std::string variable = "BOILERPLATE_";
+    for (const char* c = entry.name; *c; c++) variable += char(toupper(*c));
+
+    if (const char* value = getenv(variable.c_str())) {
+      if (!set(entry.name, value)) return false;
+    }
+  }
+
+  return true;
+}
+
+// Create a context with these settings applied. 'defaultMaxHeapBytes' is used
+// if no maximum heap size was configured.
+JSContext* boilerplate::RuntimeConfig::newContext(
+    JSRuntime* parentRuntime, uint32_t defaultMaxHeapBytes) const {
+  JSContext* cx =
+      JS_NewContext(maxHeapBytes.value_or(defaultMaxHeapBytes), parentRuntime);
+  if (!cx) return nullptr;
+
+  apply(cx);
+  return cx;
+}
+
+// Apply the GC and JIT settings to an existing context.
+//
+// NOTE: The JIT warmup thresholds are process-wide, so they also affect any
+// other contexts.
+void boilerplate::RuntimeConfig::apply(JSContext* cx) const {
+  if (maxHeapBytes) JS_SetGCParameter(cx, JSGC_MAX_BYTES, *maxHeapBytes);
+
+  // The nursery bounds must stay ordered (min <= max) after each call, so pick
+  // the order in which to change them depending on the current values.
+  if (minNurseryBytes || maxNurseryBytes) {
+    uint32_t currentMin = JS_GetGCParameter(cx, JSGC_MIN_NURSERY_BYTES);
+    uint32_t currentMax = JS_GetGCParameter(cx, JSGC_MAX_NURSERY_BYTES);
+    uint32_t newMin = minNurseryBytes.value_or(currentMin);
+    uint32_t newMax = maxNurseryBytes.value_or(currentMax);
+
+    if (newMin > newMax) {
+      fprintf(stderr, "Warning: ignoring nursery sizes, minimum > maximum\n");
+    } else if (newMax >= currentMin) {
+      JS_SetGCParameter(cx, JSGC_MAX_NURSERY_BYTES, newMax);
+      JS_SetGCParameter(cx, JSGC_MIN_NURSERY_BYTES, newMin);
+    } else {
+      JS_SetGCParameter(cx, JSGC_MIN_NURSERY_BYTES, newMin);
+      JS_SetGCParameter(cx, JSGC_MAX_NURSERY_BYTES, newMax);
+    }
+  }
+
+  if (sliceBudgetMs)
+    JS_SetGCParameter(cx, JSGC_SLICE_TIME_BUDGET_MS, *sliceBudgetMs);
+  if (incrementalGC)
+    JS_SetGCParameter(cx, JSGC_INCREMENTAL_GC_ENABLED, *incrementalGC != 0);
+  if (perZoneGC)
+    JS_SetGCParameter(cx, JSGC_PER_ZONE_GC_ENABLED, *perZoneGC != 0);
+
+  if (baselineInterpreterWarmup) {
+    JS_SetGlobalJitCompilerOption(
+        cx, JSJITCOMPILER_BASELINE_INTERPRETER_WARMUP_TRIGGER,
+        *baselineInterpreterWarmup);
+  }
+  if (baselineWarmup) {
+    JS_SetGlobalJitCompilerOption(cx, JSJITCOMPILER_BASELINE_WARMUP_TRIGGER,
+                                  *baselineWarmup);
+  }
+  if (ionWarmup) {
+    JS_SetGlobalJitCompilerOption(cx, JSJITCOMPILER_ION_NORMAL_WARMUP_TRIGGER,
+                                  *ionWarmup);
+  }
+}
+
 // Initialize the JS environment, create a JSContext and run the example
 // function in that context. By default the self-hosting environment is
-// initialized as it is needed to run any JavaScript). If the 'initSelfHosting'
-// argument is false, we will not initialize self-hosting and instead leave
-// that to the caller.
+// initialized (as it is needed to run any JavaScript; see InitSelfHostedCode()
+// above). If the 'initSelfHosting' argument is false, we will not initialize
+// self-hosting and instead leave that to the caller.
+//
+// The context is tuned according to the runtime settings in the environment;
+// see RuntimeConfig above.
 bool boilerplate::RunExample(bool (*task)(JSContext*), bool initSelfHosting) {
+  RuntimeConfig config;
+  if (!config.loadEnvironment()) {
+    return false;
+  }
+
+  return RunExample(task, config, initSelfHosting);
+}
+
+bool boilerplate::RunExample(bool (*task)(JSContext*),
+                             const RuntimeConfig& config,
+                             bool initSelfHosting) {
   if (!JS_Init()) {
     return false;
   }
 
-  JSContext* cx = JS_NewContext(JS::DefaultHeapMaxBytes);
+  JSContext* cx = config.newContext();
   if (!cx) {
     return false;
   }
 
-  if (initSelfHosting && !JS::InitSelfHostedCode(cx)) {
+  if (initSelfHosting && !InitSelfHostedCode(cx)) {
     return false;
   }
 
@@ -1,3 +1,8 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
 #include <jsapi.h>
 
 // See 'boilerplate.cpp' for documentation.
@@ -7,9 +12,35 @@ namespace boilerplate {
 extern const JSClassOps DefaultGlobalClassOps;
 
 JSObject* CreateGlobal(JSContext* cx);
+JSObject* CreateGlobal(JSContext* cx, const JS::RealmOptions& options);
 
 void ReportAndClearException(JSContext* cx);
 
+bool InitSelfHostedCode(JSContext* cx);
+
+struct RuntimeConfig {
+  std::optional<uint32_t> maxHeapBytes;
+  std::optional<uint32_t> minNurseryBytes;
+  std::optional<uint32_t> maxNurseryBytes;
+  std::optional<uint32_t> sliceBudgetMs;
+  std::optional<uint32_t> incrementalGC;
+  std::optional<uint32_t> perZoneGC;
+  std::optional<uint32_t> baselineInterpreterWarmup;
+  std::optional<uint32_t> baselineWarmup;
+  std::optional<uint32_t> ionWarmup;
+
+  bool set(const char* key, const char* value);
+  bool loadFile(const char* path);
+  bool loadEnvironment();
+
+  JSContext* newContext(
+      JSRuntime* parentRuntime = nullptr,
+      uint32_t defaultMaxHeapBytes = JS::DefaultHeapMaxBytes) const;
+  void apply(JSContext* cx) const;
+};
+
 bool RunExample(bool (*task)(JSContext*), bool initSelfHosting = true);
+bool RunExample(bool (*task)(JSContext*), const RuntimeConfig& config,
+                bool initSelfHosting = true);
 
 }  // namespace boilerplate
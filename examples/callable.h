@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include <jsapi.h>
+#include <js/CallAndConstruct.h>
+#include <js/Id.h>
+#include <js/RootingAPI.h>
+#include <js/ValueArray.h>
+
+#include "native_binding.h"
+
+// Call a JS function from C++ with typed arguments and return value, for
+// hosts that call the same script callback very often:
+//
+//   boilerplate::Callable<double(int32_t, std::string)> onEvent;
+//   if (!onEvent.init(cx, global, "onEvent")) return false;
+//   ...
+//   double result;
+//   if (!onEvent.call(cx, 42, "click", &result)) return false;
+//
+// JS_CallFunctionName() atomizes the name and looks it up on every call, and
+// the arguments have to be rooted in a JS::RootedValueArray by hand. Callable
+// pins the name's atom and keeps the function in a persistent root, and
+// converts the arguments and return value with the converters from
+// 'native_binding.h'. For a Callable<void(...)>, call() has no result
+// argument.
+//
+// Script can assign a new function to the name at any time. By default, each
+// call reads the property again through the pinned key, which is much cheaper
+// than looking it up by name, and picks up the new function if it changed;
+// rebinds() counts how often that happened. A host that knows the binding
+// won't change can call setCheckBinding(false) to skip the read entirely, and
+// then call refresh() itself if needed. A Callable initialized with a function
+// value rather than a name is never rebound.
+//
+// The function is called with the object it was looked up on as `this`.
+//
+// Callable holds persistent roots, so it must be destroyed before its context.
+
+namespace boilerplate {
+
+template <typename Signature>
+class Callable;
+
+template <typename R, typename... Args>
+class Callable<R(Args...)> {
+  static_assert(std::is_void_v<R> ||
+                    !(std::is_same_v<R, std::string_view> ||
+                      std::is_same_v<R, JS::HandleValue>),
+                "the result must be a value that outlives the call");
+
+ public:
+  Callable() = default;
+
+  Callable(const Callable&) = delete;
+  Callable& operator=(const Callable&) = delete;
+
+  // Call the function that is the `name` property of holder.
+  bool init(JSContext* cx, JS::HandleObject holder, const char* name) {
+    JSString* atom = JS_AtomizeAndPinString(cx, name);
+    if (!atom) return false;
+    m_id = JS::PropertyKey::fromPinnedString(atom);
+    m_name = name;
+
+    m_holder.init(cx, holder);
+    m_callee.init(cx);
+    return refresh(cx);
+  }
+
+  // Call this function value, whatever it is later bound to.
+  bool init(JSContext* cx, JS::HandleValue function) {
+    if (!function.isObject() || !JS::IsCallable(&function.toObject())) {
+      JS_ReportErrorASCII(cx, "value is not a function");
+      return false;
+    }
+    m_callee.init(cx, function);
+    return true;
+  }
+
+  bool call(JSContext* cx, const Args&... args)
+    requires std::is_void_v<R>
+  {
+    JS::RootedValue rval(cx);
+    return invoke(cx, &rval, args...);
+  }
+
+  bool call(JSContext* cx, const Args&... args, R* result)
+    requires(!std::is_void_v<R>)
+  {
+    JS::RootedValue rval(cx);
+    if (!invoke(cx, &rval, args...)) return false;
+
+    typename detail::ArgConverter<R>::Storage storage;
+    if (!detail::ArgConverter<R>::convert(cx, rval, &storage)) return false;
+    *result = detail::ArgConverter<R>::unwrap(storage);
+    return true;
+  }
+
+  // Read the property again, and use the new function if it was rebound.
+  bool refresh(JSContext* cx) {
+    if (!m_holder.initialized()) return true;
+
+    JS::RootedValue v(cx);
+    if (!JS_GetPropertyById(cx, m_holder,
+                            JS::HandleId::fromMarkedLocation(&m_id), &v)) {
+      return false;
+    }
+    if (v.isObject() && v.asRawBits() == m_callee.get().asRawBits()) {
+      return true;
+    }
+
+    if (!v.isObject() || !JS::IsCallable(&v.toObject())) {
+      JS_ReportErrorASCII(cx, "%s is not a function", m_name.c_str());
+      return false;
+    }
+
+    if (!m_callee.isUndefined()) m_rebinds++;
+    m_callee.set(v);
+    return true;
+  }
+
+  void setCheckBinding(bool check) { m_checkBinding = check; }
+  uint64_t rebinds() const { return m_rebinds; }
+
+ private:
+  bool invoke(JSContext* cx, JS::MutableHandleValue rval,
+              const Args&... args) {
+    if (m_checkBinding && !refresh(cx)) return false;
+
+    JS::RootedObject thisObj(cx,
+                             m_holder.initialized() ? m_holder.get() : nullptr);
+
+    if constexpr (sizeof...(Args) == 0) {
+      return JS_CallFunctionValue(cx, thisObj, m_callee,
+                                  JS::HandleValueArray::empty(), rval);
+    } else {
+      JS::RootedValueArray<sizeof...(Args)> argv(cx);
+      size_t i = 0;
+      if (!(detail::ReturnConverter<detail::ArgType<Args>>::set(cx, args,
+                                                                argv[i++]) &&
+            ...)) {
+        return false;
+      }
+      return JS_CallFunctionValue(cx, thisObj, m_callee, argv, rval);
+    }
+  }
+
+  JS::PersistentRooted<JSObject*> m_holder;
+  JS::PersistentRooted<JS::Value> m_callee;
+  // A pinned atom, which needs no rooting.
+  JS::PropertyKey m_id;
+  std::string m_name;
+  bool m_checkBinding = true;
+  uint64_t m_rebinds = 0;
+};
+
+}  // namespace boilerplate
@@ -0,0 +1,771 @@
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#  include <immintrin.h>
+#  define BOILERPLATE_HAVE_SHA_NI 1
+#endif
+
+#include <jsapi.h>
+#include <js/ArrayBuffer.h>
+#include <js/CallArgs.h>
+#include <js/Conversions.h>
+#include <js/PropertySpec.h>
+#include <js/String.h>
+#include <js/Wrapper.h>
+#include <js/experimental/TypedData.h>
+
+#include "content_hash.h"
+
+// Content hashing for strings and binary data, exposed to script as
+//
+//   "text".md5sum, "text".sha256sum, "text".xxh64sum
+//   contentHash(stringOrArrayBufferView, "md5" | "sha256" | "xxh64")
+//
+// each returning a lowercase hex digest. Strings are hashed as UTF-8, so the
+// result matches the md5sum or sha256sum of a UTF-8 file with the same text.
+//
+// Strings are hashed directly from SpiderMonkey's own storage, without first
+// converting the whole string to UTF-8: runs of ASCII characters in Latin-1
+// strings are fed to the hash as they are, and everything else is converted in
+// small chunks on the stack.
+//
+// MD5 and SHA-256 process one 64-byte block at a time, and each block depends
+// on the previous one, so there is little to vectorize in a single stream. On
+// x86-64 processors with the SHA extensions, SHA-256 blocks are processed with
+// those instructions instead. xxHash64 is the one to use when the hash doesn't
+// need to be cryptographic; it is several times faster than either.
+//
+// Hashes of pinned atoms (for example, strings returned from
+// boilerplate::InternString()) are memoized, since those strings never change
+// or move. Other strings can be moved by the GC, so their results cannot be
+// cached by address. The memoized hashes are per thread, like the runtime the
+// atoms belong to; call ResetContentHashing() before destroying the thread's
+// context, since a later runtime could reuse the atoms' addresses.
+
+/**** HASH KERNELS ************************************************************/
+
+namespace {
+
+inline uint32_t RotateLeft32(uint32_t x, int n) {
+  return (x << n) | (x >> (32 - n));
+}
+
+inline uint32_t RotateRight32(uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+inline uint64_t RotateLeft64(uint64_t x, int n) {
+  return (x << n) | (x >> (64 - n));
+}
+
+inline uint32_t LoadLE32(const uint8_t* p) {
+  return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 |
+         uint32_t(p[3]) << 24;
+}
+
+inline uint64_t LoadLE64(const uint8_t* p) {
+  return uint64_t(LoadLE32(p)) | uint64_t(LoadLE32(p + 4)) << 32;
+}
+
+inline uint32_t LoadBE32(const uint8_t* p) {
+  return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 |
+         uint32_t(p[3]);
+}
+
+void AppendHex(boilerplate::HexDigest* digest, const uint8_t* bytes,
+               size_t count) {
+  static const char hex[] = "0123456789abcdef";
+  for (size_t i = 0; i < count; i++) {
+    digest->chars[digest->length++] = hex[bytes[i] >> 4];
+    digest->chars[digest->length++] = hex[bytes[i] & 0xf];
+  }
+}
+
+// The buffering and padding shared by MD5 and SHA-256, which both work on
+// 64-byte blocks and end with the message length in bits. Derived classes
+// provide processBlocks() and finishDigest().
+template <typename Derived, bool BigEndianLength>
+class BlockHasher {
+ public:
+  void update(const uint8_t* data, size_t length) {
+    m_totalLength += length;
+
+    if (m_buffered > 0) {
+      size_t n = std::min(length, sizeof(m_buffer) - m_buffered);
+      memcpy(m_buffer + m_buffered, data, n);
+      m_buffered += n;
+      data += n;
+      length -= n;
+      if (m_buffered < sizeof(m_buffer)) return;
+      derived()->processBlocks(m_buffer, 1);
+      m_buffered = 0;
+    }
+
+    size_t blocks = length / 64;
+    if (blocks > 0) {
+      derived()->processBlocks(data, blocks);
+      data += blocks * 64;
+      length -= blocks * 64;
+    }
+
+    memcpy(m_buffer, data, length);
+    m_buffered = length;
+  }
+
+  void finish(boilerplate::HexDigest* digest) {
+    uint64_t bitLength = m_totalLength * 8;
+
+    uint8_t padding[72] = {0x80};
+    size_t padLength = (m_buffered < 56 ? 56 : 120) - m_buffered;
+    for (int i = 0; i < 8; i++) {
+      int shift = BigEndianLength ? 56 - 8 * i : 8 * i;
+      padding[padLength + i] = uint8_t(bitLength >> shift);
+    }
+    update(padding, padLength + 8);
+
+    derived()->finishDigest(digest);
+  }
+
+ private:
+  Derived* derived() { return static_cast<Derived*>(this); }
+
+  uint8_t m_buffer[64];
+  size_t m_buffered = 0;
+  uint64_t m_totalLength = 0;
+};
+
+class Md5 : public BlockHasher<Md5, false> {
+ public:
+  void processBlocks(const uint8_t* data, size_t blocks) {
+    static const uint32_t K[64] = {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a,
+        0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+        0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340,
+        0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+        0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8,
+        0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+        0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa,
+        0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+        0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92,
+        0xffeff47d, 0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+        0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391};
+    static const int S[16] = {7, 12, 17, 22, 5, 9,  14, 20,
+                              4, 11, 16, 23, 6, 10, 15, 21};
+
+    for (; blocks > 0; blocks--, data += 64) {
+      uint32_t M[16];
+      for (int i = 0; i < 16; i++) M[i] = LoadLE32(data + 4 * i);
+
+      uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+      for (int i = 0; i < 64; i++) {
+        uint32_t f;
+        int g;
+        if (i < 16) {
+          f = (b & c) | (~b & d);
+          g = i;
+        } else if (i < 32) {
+          f = (d & b) | (~d & c);
+          g = (5 * i + 1) % 16;
+        } else if (i < 48) {
+          f = b ^ c ^ d;
+          g = (3 * i + 5) % 16;
+        } else {
+          f = c ^ (b | ~d);
+          g = (7 * i) % 16;
+        }
+        uint32_t tmp = d;
+        d = c;
+        c = b;
+        b += RotateLeft32(a + f + K[i] + M[g], S[(i / 16) * 4 + i % 4]);
+        a = tmp;
+      }
+
+      m_state[0] += a;
+      m_state[1] += b;
+      m_state[2] += c;
+      m_state[3] += d;
+    }
+  }
+
+  void finishDigest(boilerplate::HexDigest* digest) {
+    uint8_t bytes[16];
+    for (int i = 0; i < 4; i++) {
+      for (int j = 0; j < 4; j++) {
+        bytes[4 * i + j] = uint8_t(m_state[i] >> 8 * j);
+      }
+    }
+    AppendHex(digest, bytes, sizeof(bytes));
+  }
+
+ private:
+  uint32_t m_state[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+};
+
+alignas(16) const uint32_t Sha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+void Sha256BlocksPortable(uint32_t state[8], const uint8_t* data,
+                          size_t blocks) {
+  for (; blocks > 0; blocks--, data += 64) {
+    uint32_t W[64];
+    for (int i = 0; i < 16; i++) W[i] = LoadBE32(data + 4 * i);
+    for (int i = 16; i < 64; i++) {
+      uint32_t s0 = RotateRight32(W[i - 15], 7) ^
+                    RotateRight32(W[i - 15], 18) ^ (W[i - 15] >> 3);
+      uint32_t s1 = RotateRight32(W[i - 2], 17) ^
+                    RotateRight32(W[i - 2], 19) ^ (W[i - 2] >> 10);
+      W[i] = W[i - 16] + s0 + W[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+      uint32_t S1 =
+          RotateRight32(e, 6) ^ RotateRight32(e, 11) ^ RotateRight32(e, 25);
+      uint32_t ch = (e & f) ^ (~e & g);
+      uint32_t t1 = h + S1 + ch + Sha256K[i] + W[i];
+      uint32_t S0 =
+          RotateRight32(a, 2) ^ RotateRight32(a, 13) ^ RotateRight32(a, 22);
+      uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+      uint32_t t2 = S0 + maj;
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+}
+
+#ifdef BOILERPLATE_HAVE_SHA_NI
+// SHA-256 with the x86 SHA extensions. The state is kept in the ABEF/CDGH
+// layout that the sha256rnds2 instruction expects. Each group of four rounds
+// uses one of four message registers, while the message schedule for later
+// groups is computed with sha256msg1/sha256msg2.
+__attribute__((target("sha,sse4.1,ssse3"))) void Sha256BlocksShaNi(
+    uint32_t state[8], const uint8_t* data, size_t blocks) {
+  const __m128i byteSwap =
+      _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+  __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0]));
+  __m128i state1 =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4]));
+  tmp = _mm_shuffle_epi32(tmp, 0xb1);           // CDAB
+  state1 = _mm_shuffle_epi32(state1, 0x1b);     // EFGH
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);  // ABEF
+  state1 = _mm_blend_epi16(state1, tmp, 0xf0);  // CDGH
+
+  for (; blocks > 0; blocks--, data += 64) {
+    __m128i abefSave = state0;
+    __m128i cdghSave = state1;
+
+    __m128i msgs[4];
+    for (int i = 0; i < 4; i++) {
+      msgs[i] = _mm_shuffle_epi8(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i)),
+          byteSwap);
+    }
+
+    for (int g = 0; g < 16; g++) {
+      __m128i& current = msgs[g % 4];
+      __m128i msg = _mm_add_epi32(
+          current,
+          _mm_load_si128(reinterpret_cast<const __m128i*>(&Sha256K[4 * g])));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+
+      if (g >= 3 && g <= 14) {
+        __m128i& next = msgs[(g + 1) % 4];
+        next = _mm_add_epi32(next,
+                             _mm_alignr_epi8(current, msgs[(g + 3) % 4], 4));
+        next = _mm_sha256msg2_epu32(next, current);
+      }
+
+      msg = _mm_shuffle_epi32(msg, 0x0e);
+      state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+      if (g >= 1 && g <= 12) {
+        __m128i& previous = msgs[(g + 3) % 4];
+        previous = _mm_sha256msg1_epu32(previous, current);
+      }
+    }
+
+    state0 = _mm_add_epi32(state0, abefSave);
+    state1 = _mm_add_epi32(state1, cdghSave);
+  }
+
+  tmp = _mm_shuffle_epi32(state0, 0x1b);        // FEBA
+  state1 = _mm_shuffle_epi32(state1, 0xb1);     // DCHG
+  state0 = _mm_blend_epi16(tmp, state1, 0xf0);  // DCBA
+  state1 = _mm_alignr_epi8(state1, tmp, 8);     // ABEF
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+}
+#endif  // BOILERPLATE_HAVE_SHA_NI
+
+using Sha256BlocksFn = void (*)(uint32_t*, const uint8_t*, size_t);
+
+Sha256BlocksFn SelectSha256Blocks() {
+#ifdef BOILERPLATE_HAVE_SHA_NI
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1")) {
+    return Sha256BlocksShaNi;
+  }
+#endif
+  return Sha256BlocksPortable;
+}
+
+const Sha256BlocksFn sha256Blocks = SelectSha256Blocks();
+
+class Sha256 : public BlockHasher<Sha256, true> {
+ public:
+  void processBlocks(const uint8_t* data, size_t blocks) {
+    sha256Blocks(m_state, data, blocks);
+  }
+
+  void finishDigest(boilerplate::HexDigest* digest) {
+    uint8_t bytes[32];
+    for (int i = 0; i < 8; i++) {
+      for (int j = 0; j < 4; j++) {
+        bytes[4 * i + j] = uint8_t(m_state[i] >> (24 - 8 * j));
+      }
+    }
+    AppendHex(digest, bytes, sizeof(bytes));
+  }
+
+ private:
+  uint32_t m_state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                         0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+};
+
+// xxHash64 with a seed of 0, in streaming form.
+class XxHash64 {
+  static constexpr uint64_t P1 = 0x9e3779b185ebca87ULL;
+  static constexpr uint64_t P2 = 0xc2b2ae3d27d4eb4fULL;
+  static constexpr uint64_t P3 = 0x165667b19e3779f9ULL;
+  static constexpr uint64_t P4 = 0x85ebca77c2b2ae63ULL;
+  static constexpr uint64_t P5 = 0x27d4eb2f165667c5ULL;
+
+  static uint64_t Round(uint64_t acc, uint64_t input) {
+    acc += input * P2;
+    return RotateLeft64(acc, 31) * P1;
+  }
+
+  static uint64_t MergeRound(uint64_t acc, uint64_t value) {
+    acc ^= Round(0, value);
+    return acc * P1 + P4;
+  }
+
+  void processStripes(const uint8_t* data, size_t stripes) {
+    uint64_t v0 = m_acc[0], v1 = m_acc[1], v2 = m_acc[2], v3 = m_acc[3];
+    for (; stripes > 0; stripes--, data += 32) {
+      v0 = Round(v0, LoadLE64(data));
+      v1 = Round(v1, LoadLE64(data + 8));
+      v2 = Round(v2, LoadLE64(data + 16));
+      v3 = Round(v3, LoadLE64(data + 24));
+    }
+    m_acc[0] = v0;
+    m_acc[1] = v1;
+    m_acc[2] = v2;
+    m_acc[3] = v3;
+  }
+
+ public:
+  void update(const uint8_t* data, size_t length) {
+    m_totalLength += length;
+
+    if (m_buffered > 0) {
+      size_t n = std::min(length, sizeof(m_buffer) - m_buffered);
+      memcpy(m_buffer + m_buffered, data, n);
+      m_buffered += n;
+      data += n;
+      length -= n;
+      if (m_buffered < sizeof(m_buffer)) return;
+      processStripes(m_buffer, 1);
+      m_buffered = 0;
+    }
+
+    size_t stripes = length / 32;
+    if (stripes > 0) {
+      processStripes(data, stripes);
+      data += stripes * 32;
+      length -= stripes * 32;
+    }
+
+    memcpy(m_buffer, data, length);
+    m_buffered = length;
+  }
+
+  void finish(boilerplate::HexDigest* digest) {
+    uint64_t h;
+    if (m_totalLength >= 32) {
+      h = RotateLeft64(m_acc[0], 1) + RotateLeft64(m_acc[1], 7) +
+          RotateLeft64(m_acc[2], 12) + RotateLeft64(m_acc[3], 18);
+      for (uint64_t acc : m_acc) h = MergeRound(h, acc);
+    } else {
+      h = P5;
+    }
+    h += m_totalLength;
+
+    const uint8_t* p = m_buffer;
+    size_t remaining = m_buffered;
+    for (; remaining >= 8; remaining -= 8, p += 8) {
+      h ^= Round(0, LoadLE64(p));
+      h = RotateLeft64(h, 27) * P1 + P4;
+    }
+    if (remaining >= 4) {
+      h ^= uint64_t(LoadLE32(p)) * P1;
+      h = RotateLeft64(h, 23) * P2 + P3;
+      remaining -= 4;
+      p += 4;
+    }
+    for (; remaining > 0; remaining--, p++) {
+      h ^= *p * P5;
+      h = RotateLeft64(h, 11) * P1;
+    }
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; i++) bytes[i] = uint8_t(h >> (56 - 8 * i));
+    AppendHex(digest, bytes, sizeof(bytes));
+  }
+
+ private:
+  uint64_t m_acc[4] = {P1 + P2, P2, 0, 0 - P1};
+  uint8_t m_buffer[32];
+  size_t m_buffered = 0;
+  uint64_t m_totalLength = 0;
+};
+
+// Run 'feed' with a hasher for the algorithm, and return the digest.
+template <typename Feed>
+boilerplate::HexDigest RunHash(boilerplate::HashAlgorithm algorithm,
+                               Feed&& feed) {
+  boilerplate::HexDigest digest;
+  switch (algorithm) {
+    case boilerplate::HashAlgorithm::MD5: {
+      Md5 hasher;
+      feed(hasher);
+      hasher.finish(&digest);
+      break;
+    }
+    case boilerplate::HashAlgorithm::SHA256: {
+      Sha256 hasher;
+      feed(hasher);
+      hasher.finish(&digest);
+      break;
+    }
+    case boilerplate::HashAlgorithm::XXH64: {
+      XxHash64 hasher;
+      feed(hasher);
+      hasher.finish(&digest);
+      break;
+    }
+  }
+  return digest;
+}
+
+// The length of the run of ASCII characters at the start of 'chars', checking
+// eight at a time.
+size_t AsciiPrefixLength(const uint8_t* chars, size_t length) {
+  size_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    uint64_t word;
+    memcpy(&word, chars + i, sizeof(word));
+    if (word & 0x8080808080808080ULL) break;
+  }
+  while (i < length && chars[i] < 0x80) i++;
+  return i;
+}
+
+// Feed Latin-1 characters to the hasher as UTF-8.
+template <typename Hasher>
+void FeedLatin1(Hasher& hasher, const uint8_t* chars, size_t length) {
+  uint8_t buf[256];
+  size_t i = 0;
+  while (i < length) {
+    size_t run = AsciiPrefixLength(chars + i, length - i);
+    if (run > 0) {
+      hasher.update(chars + i, run);
+      i += run;
+      continue;
+    }
+
+    // Characters U+0080 to U+00FF are two bytes each in UTF-8.
+    size_t n = 0;
+    for (; i < length && chars[i] >= 0x80 && n + 2 <= sizeof(buf); i++) {
+      buf[n++] = uint8_t(0xc0 | (chars[i] >> 6));
+      buf[n++] = uint8_t(0x80 | (chars[i] & 0x3f));
+    }
+    hasher.update(buf, n);
+  }
+}
+
+// Feed UTF-16 code units to the hasher as UTF-8. Unpaired surrogates become
+// U+FFFD, as in JS_EncodeStringToUTF8().
+template <typename Hasher>
+void FeedTwoByte(Hasher& hasher, const char16_t* chars, size_t length) {
+  uint8_t buf[256];
+  size_t n = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (n + 4 > sizeof(buf)) {
+      hasher.update(buf, n);
+      n = 0;
+    }
+
+    uint32_t c = chars[i];
+    if (c < 0x80) {
+      buf[n++] = uint8_t(c);
+      continue;
+    }
+    if (c < 0x800) {
+      buf[n++] = uint8_t(0xc0 | (c >> 6));
+      buf[n++] = uint8_t(0x80 | (c & 0x3f));
+      continue;
+    }
+
+    if (c >= 0xd800 && c <= 0xdfff) {
+      if (c <= 0xdbff && i + 1 < length && chars[i + 1] >= 0xdc00 &&
+          chars[i + 1] <= 0xdfff) {
+        c = 0x10000 + ((c - 0xd800) << 10) + (chars[i + 1] - 0xdc00);
+        i++;
+        buf[n++] = uint8_t(0xf0 | (c >> 18));
+        buf[n++] = uint8_t(0x80 | ((c >> 12) & 0x3f));
+        buf[n++] = uint8_t(0x80 | ((c >> 6) & 0x3f));
+        buf[n++] = uint8_t(0x80 | (c & 0x3f));
+        continue;
+      }
+      c = 0xfffd;
+    }
+    buf[n++] = uint8_t(0xe0 | (c >> 12));
+    buf[n++] = uint8_t(0x80 | ((c >> 6) & 0x3f));
+    buf[n++] = uint8_t(0x80 | (c & 0x3f));
+  }
+  hasher.update(buf, n);
+}
+
+}  // namespace
+
+boilerplate::HexDigest boilerplate::HashBytes(HashAlgorithm algorithm,
+                                              const uint8_t* data,
+                                              size_t length) {
+  return RunHash(algorithm,
+                 [data, length](auto& hasher) { hasher.update(data, length); });
+}
+
+/**** JSAPI BINDINGS **********************************************************/
+
+using MemoCache = std::unordered_map<uintptr_t, boilerplate::HexDigest>;
+
+static thread_local MemoCache s_memoCache;
+
+// Enough for the strings an embedding interns; beyond that, start over.
+static constexpr size_t MaxMemoizedDigests = 4096;
+
+// Look up a memoized digest. Pinned atoms are never moved or collected, so
+// their address identifies their contents for the lifetime of the runtime.
+static MemoCache* MemoCacheFor(JSContext* cx, JSString* str) {
+  if (!JS_StringHasBeenPinned(cx, str)) return nullptr;
+  return &s_memoCache;
+}
+
+static uintptr_t MemoKey(JSString* str, boilerplate::HashAlgorithm algorithm) {
+  // GC things are at least 8-byte aligned, leaving room for the algorithm.
+  return reinterpret_cast<uintptr_t>(str) | uintptr_t(algorithm);
+}
+
+bool boilerplate::HashString(JSContext* cx, JS::HandleString str,
+                             HashAlgorithm algorithm, HexDigest* digest) {
+  MemoCache* cache = MemoCacheFor(cx, str);
+  if (cache) {
+    auto entry = cache->find(MemoKey(str, algorithm));
+    if (entry != cache->end()) {
+      *digest = entry->second;
+      return true;
+    }
+  }
+
+  JSLinearString* linear = JS_EnsureLinearString(cx, str);
+  if (!linear) return false;
+
+  {
+    JS::AutoCheckCannotGC nogc;
+    size_t length = JS::GetLinearStringLength(linear);
+    if (JS::LinearStringHasLatin1Chars(linear)) {
+      const JS::Latin1Char* chars =
+          JS::GetLatin1LinearStringChars(nogc, linear);
+      *digest = RunHash(algorithm, [chars, length](auto& hasher) {
+        FeedLatin1(hasher, chars, length);
+      });
+    } else {
+      const char16_t* chars = JS::GetTwoByteLinearStringChars(nogc, linear);
+      *digest = RunHash(algorithm, [chars, length](auto& hasher) {
+        FeedTwoByte(hasher, chars, length);
+      });
+    }
+  }
+
+  if (cache) {
+    if (cache->size() >= MaxMemoizedDigests) cache->clear();
+    cache->emplace(MemoKey(str, algorithm), *digest);
+  }
+  return true;
+}
+
+static bool ReturnDigest(JSContext* cx, const boilerplate::HexDigest& digest,
+                         JS::MutableHandleValue rval) {
+  JSString* str = JS_NewStringCopyN(cx, digest.chars, digest.length);
+  if (!str) return false;
+  rval.setString(str);
+  return true;
+}
+
+template <boilerplate::HashAlgorithm Algorithm>
+static bool StringHashGetter(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  JS::RootedString str(cx, JS::ToString(cx, args.thisv()));
+  if (!str) return false;
+
+  boilerplate::HexDigest digest;
+  if (!boilerplate::HashString(cx, str, Algorithm, &digest)) return false;
+  return ReturnDigest(cx, digest, args.rval());
+}
+
+static bool ParseAlgorithm(JSContext* cx, JS::HandleValue v,
+                           boilerplate::HashAlgorithm* algorithm) {
+  if (v.isUndefined()) {
+    *algorithm = boilerplate::HashAlgorithm::SHA256;
+    return true;
+  }
+
+  JS::RootedString name(cx, JS::ToString(cx, v));
+  if (!name) return false;
+
+  static const struct {
+    const char* name;
+    boilerplate::HashAlgorithm algorithm;
+  } algorithms[] = {{"md5", boilerplate::HashAlgorithm::MD5},
+                    {"sha256", boilerplate::HashAlgorithm::SHA256},
+                    {"xxh64", boilerplate::HashAlgorithm::XXH64}};
+
+  for (const auto& entry : algorithms) {
+    bool match;
+    if (!JS_StringEqualsAscii(cx, name, entry.name, &match)) return false;
+    if (match) {
+      *algorithm = entry.algorithm;
+      return true;
+    }
+  }
+
+  JS_ReportErrorASCII(cx, "unknown hash algorithm");
+  return false;
+}
+
+// contentHash(data, algorithm = "sha256")
+static bool ContentHash(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  if (!args.requireAtLeast(cx, "contentHash", 1)) return false;
+
+  boilerplate::HashAlgorithm algorithm;
+  if (!ParseAlgorithm(cx, args.get(1), &algorithm)) return false;
+
+  // A typed array or DataView from another global arrives as a
+  // cross-compartment wrapper.
+  JS::RootedObject view(cx);
+  if (args[0].isObject()) {
+    view = js::CheckedUnwrapStatic(&args[0].toObject());
+    if (!view) {
+      JS_ReportErrorASCII(cx, "contentHash: permission denied");
+      return false;
+    }
+    if (!JS_IsArrayBufferViewObject(view)) view = nullptr;
+  }
+
+  boilerplate::HexDigest digest;
+  if (view) {
+    bool detached;
+    {
+      JSAutoRealm ar(cx, view);
+      bool isSharedMemory;
+      JSObject* buffer = JS_GetArrayBufferViewBuffer(cx, view, &isSharedMemory);
+      if (!buffer) return false;
+      detached = !isSharedMemory && JS::IsDetachedArrayBufferObject(buffer);
+    }
+    // Otherwise a detached buffer would hash like an empty one.
+    if (detached) {
+      JS_ReportErrorASCII(cx, "contentHash: the ArrayBuffer is detached");
+      return false;
+    }
+
+    size_t length = JS_GetArrayBufferViewByteLength(view);
+    bool isSharedMemory;
+    JS::AutoCheckCannotGC nogc;
+    auto* data = static_cast<const uint8_t*>(
+        JS_GetArrayBufferViewData(view, &isSharedMemory, nogc));
+    digest = boilerplate::HashBytes(algorithm, data, length);
+  } else {
+    JS::RootedString str(cx, JS::ToString(cx, args[0]));
+    if (!str) return false;
+    if (!boilerplate::HashString(cx, str, algorithm, &digest)) return false;
+  }
+
+  return ReturnDigest(cx, digest, args.rval());
+}
+
+static const JSPropertySpec stringHashProperties[] = {
+    JS_PSG("md5sum", StringHashGetter<boilerplate::HashAlgorithm::MD5>,
+           JSPROP_ENUMERATE),
+    JS_PSG("sha256sum", StringHashGetter<boilerplate::HashAlgorithm::SHA256>,
+           JSPROP_ENUMERATE),
+    JS_PSG("xxh64sum", StringHashGetter<boilerplate::HashAlgorithm::XXH64>,
+           JSPROP_ENUMERATE),
+    JS_PS_END};
+
+// Define the String.prototype getters and the contentHash() function in the
+// given global.
+bool boilerplate::DefineContentHashing(JSContext* cx,
+                                       JS::HandleObject global) {
+  JS::RootedObject stringProto(cx);
+  if (!JS_GetClassPrototype(cx, JSProto_String, &stringProto)) return false;
+
+  if (!JS_DefineProperties(cx, stringProto, stringHashProperties)) {
+    return false;
+  }
+
+  if (!JS_DefineFunction(cx, global, "contentHash", ContentHash, 2, 0)) {
+    return false;
+  }
+
+  return true;
+}
+
+// Forget the memoized hashes of the context that is about to be destroyed.
+void boilerplate::ResetContentHashing(JSContext* cx) { s_memoCache.clear(); }
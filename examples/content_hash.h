@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include <jsapi.h>
+#include <js/RootingAPI.h>
+
+// See 'content_hash.cpp' for documentation.
+
+namespace boilerplate {
+
+enum class HashAlgorithm { MD5, SHA256, XXH64 };
+
+struct HexDigest {
+  static constexpr size_t MaxLength = 64;
+
+  char chars[MaxLength];
+  size_t length = 0;
+
+  std::string_view view() const { return {chars, length}; }
+};
+
+HexDigest HashBytes(HashAlgorithm algorithm, const uint8_t* data,
+                    size_t length);
+
+bool HashString(JSContext* cx, JS::HandleString str, HashAlgorithm algorithm,
+                HexDigest* digest);
+
+bool DefineContentHashing(JSContext* cx, JS::HandleObject global);
+void ResetContentHashing(JSContext* cx);
+
+}  // namespace boilerplate
@@ -0,0 +1,149 @@
+#include <jsapi.h>
+
+#include <js/Initialization.h>
+
+#include "boilerplate.h"
+#include "context_pool.h"
+
+// A pool of warmed-up JSContexts, for embeddings that run many short tasks.
+//
+// boilerplate::RunExample() pays for the full engine bring-up on every run:
+// creating a context, initializing the self-hosted code, and creating a global.
+// For a single example that doesn't matter, but an embedding that runs many
+// small scripts per second would spend most of its time there.
+//
+// SpiderMonkey only allows one JSContext per thread, so each pooled context
+// lives on its own thread, as a child of the main thread's runtime (the same
+// setup as in worker.cpp.) Tasks are queued and picked up by whichever context
+// is idle. Each context keeps a prebuilt global ready, and after every task
+// replaces it with a fresh one, so that no state leaks from one task to the
+// next and the cost of creating the global is not paid while a caller waits.
+//
+// The pooled contexts are created with the given runtime settings; see
+// boilerplate::RuntimeConfig.
+//
+// NOTE: The pool must be destroyed before the parent context is destroyed and
+// before JS_ShutDown() is called.
+
+boilerplate::ContextPool::ContextPool(JSRuntime* parentRuntime, size_t size,
+                                      const RuntimeConfig& config)
+    : m_parentRuntime(parentRuntime),
+      m_size(size),
+      m_config(config),
+      m_startedCount(0),
+      m_aliveCount(0),
+      m_startupFailed(false),
+      m_shuttingDown(false) {}
+
+boilerplate::ContextPool::~ContextPool() {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_shuttingDown = true;
+  }
+  m_wakeup.notify_all();
+
+  for (std::thread& thread : m_threads) thread.join();
+
+  // If all the contexts failed to start, nobody will run the remaining tasks.
+  for (Lease& lease : m_queue) lease.result.set_value(false);
+}
+
+// Start the pooled contexts and wait until they are all ready to accept tasks.
+// Returns false if any of them could not be created.
+bool boilerplate::ContextPool::init() {
+  for (size_t i = 0; i < m_size; i++) {
+    m_threads.emplace_back(&ContextPool::workerMain, this);
+  }
+
+  std::unique_lock<std::mutex> guard(m_lock);
+  m_started.wait(guard, [this] { return m_startedCount == m_size; });
+  return !m_startupFailed;
+}
+
+// Queue a task to run on the next idle context. The returned future resolves
+// to the task's return value once it has finished.
+std::future<bool> boilerplate::ContextPool::submit(Task task) {
+  Lease lease{std::move(task), std::promise<bool>()};
+  std::future<bool> result = lease.result.get_future();
+
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    // Without a context to run it, the task would wait forever.
+    if (m_aliveCount == 0) {
+      lease.result.set_value(false);
+      return result;
+    }
+    m_queue.push_back(std::move(lease));
+  }
+  m_wakeup.notify_one();
+  return result;
+}
+
+// 'alive' is whether the context will take tasks; it may do so even if it
+// could not create its first global.
+void boilerplate::ContextPool::workerStarted(bool ok, bool alive) {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_startedCount++;
+    if (alive) m_aliveCount++;
+    if (!ok) m_startupFailed = true;
+  }
+  m_started.notify_all();
+}
+
+// Block until there is a task to run. Returns false when the pool is being
+// destroyed and there is no more work left.
+bool boilerplate::ContextPool::nextLease(Lease* lease) {
+  std::unique_lock<std::mutex> guard(m_lock);
+  m_wakeup.wait(guard, [this] { return m_shuttingDown || !m_queue.empty(); });
+  if (m_queue.empty()) return false;
+
+  *lease = std::move(m_queue.front());
+  m_queue.pop_front();
+  return true;
+}
+
+void boilerplate::ContextPool::workerMain() {
+  JSContext* cx = m_config.newContext(m_parentRuntime);
+  if (!cx) {
+    workerStarted(false, false);
+    return;
+  }
+
+  if (!InitSelfHostedCode(cx)) {
+    JS_DestroyContext(cx);
+    workerStarted(false, false);
+    return;
+  }
+
+  {
+    JS::PersistentRooted<JSObject*> global(cx, CreateGlobal(cx));
+    workerStarted(bool(global), true);
+
+    Lease lease;
+    while (nextLease(&lease)) {
+      // A previous reset may have failed to create a replacement global.
+      if (!global) global = CreateGlobal(cx);
+      if (!global) {
+        lease.result.set_value(false);
+        continue;
+      }
+
+      bool ok;
+      {
+        JSAutoRealm ar(cx, global);
+        ok = lease.task(cx, global);
+        if (!ok && JS_IsExceptionPending(cx)) ReportAndClearException(cx);
+      }
+      lease.result.set_value(ok);
+      lease.task = nullptr;
+
+      // Reset the context for the next lease. The used global becomes garbage
+      // and the replacement is prepared before we wait for the next task.
+      global = CreateGlobal(cx);
+      JS_MaybeGC(cx);
+    }
+  }
+
+  JS_DestroyContext(cx);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <jsapi.h>
+
+#include "boilerplate.h"
+
+// See 'context_pool.cpp' for documentation.
+
+namespace boilerplate {
+
+class ContextPool {
+ public:
+  // A task runs inside the realm of 'global', on the pooled context's thread.
+  using Task = std::function<bool(JSContext* cx, JS::HandleObject global)>;
+
+  ContextPool(JSRuntime* parentRuntime, size_t size,
+              const RuntimeConfig& config = {});
+  ~ContextPool();
+
+  ContextPool(const ContextPool&) = delete;
+  ContextPool& operator=(const ContextPool&) = delete;
+
+  bool init();
+
+  std::future<bool> submit(Task task);
+  bool run(Task task) { return submit(std::move(task)).get(); }
+
+  size_t size() const { return m_threads.size(); }
+
+ private:
+  struct Lease {
+    Task task;
+    std::promise<bool> result;
+  };
+
+  void workerMain();
+  bool nextLease(Lease* lease);
+  void workerStarted(bool ok, bool alive);
+
+  JSRuntime* m_parentRuntime;
+  size_t m_size;
+  RuntimeConfig m_config;
+  std::vector<std::thread> m_threads;
+
+  std::mutex m_lock;
+  std::condition_variable m_wakeup;
+  std::condition_variable m_started;
+  std::deque<Lease> m_queue;
+  size_t m_startedCount;
+  size_t m_aliveCount;  // contexts that are taking tasks
+  bool m_startupFailed : 1;
+  bool m_shuttingDown : 1;
+};
+
+}  // namespace boilerplate
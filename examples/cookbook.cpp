@@ -14,6 +14,12 @@
 #include <js/ValueArray.h>
 
 #include "boilerplate.h"
+#include "callable.h"
+#include "content_hash.h"
+#include "cookbook_classes.h"
+#include "error_policy.h"
+#include "property_keys.h"
+#include "script_cache.h"
 
 // This example program shows the SpiderMonkey JSAPI equivalent for a handful
 // of common JavaScript idioms.
@@ -209,9 +215,12 @@ static bool CreateObject(JSContext* cx) {
  * - call JS::Construct to simulate the new keyword
  */
 static bool ConstructObjectWithNew(JSContext* cx, JS::HandleObject global) {
-  // Step 1 - Get the value of `Person` and check that it is an object.
+  // Step 1 - Get the value of `Person` and check that it is an object. The
+  // name is looked up with a pre-atomized key; see "Getting a property".
   JS::RootedValue constructor_val(cx);
-  if (!JS_GetProperty(cx, global, "Person", &constructor_val)) return false;
+  if (!boilerplate::GetProperty(cx, global, boilerplate::Key::Person,
+                                &constructor_val))
+    return false;
   if (!constructor_val.isObject()) {
     JS_ReportErrorASCII(cx, "Person is not a constructor");
     return false;
@@ -239,13 +248,8 @@ static bool ConstructObjectWithNew(JSContext* cx, JS::HandleObject global) {
   return true;
 }
 
-static bool PersonConstructor(JSContext* cx, unsigned argc, JS::Value* vp) {
-  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
-  JS::RootedObject newObject(cx, JS_NewPlainObject(cx));
-  if (!newObject) return false;
-  args.rval().setObject(*newObject);
-  return true;
-}
+// The Person constructor is in 'cookbook_classes.cpp', since 'bench.cpp' uses
+// it as well.
 
 ///// Calling a global JS function /////////////////////////////////////////////
 
@@ -265,6 +269,28 @@ static bool CallGlobalFunction(JSContext* cx, JS::HandleObject global) {
   return true;
 }
 
+///// Calling a global JS function repeatedly //////////////////////////////////
+
+/* JS_CallFunctionName() looks up the function by name on every call. When C++
+ * calls the same function over and over, look it up once with
+ * boilerplate::Callable (see 'callable.h'), which also converts the
+ * arguments and return value.
+ *
+ * // JavaScript
+ * for (let i = 0; i < 10; i++) foo();
+ */
+static bool CallGlobalFunctionRepeatedly(JSContext* cx,
+                                         JS::HandleObject global) {
+  boilerplate::Callable<void()> foo;
+  if (!foo.init(cx, global, "foo")) return false;
+
+  for (int i = 0; i < 10; i++) {
+    if (!foo.call(cx)) return false;
+  }
+
+  return true;
+}
+
 ///// Calling a JS function via a local variable ///////////////////////////////
 
 /* // JavaScript
@@ -350,33 +376,14 @@ static bool ThrowValue(JSContext* cx, JS::HandleValue exc) {
  * An example use would be to pass the filename and line number in the C++ code
  * instead:
  *
- * return ThrowError(cx, global, message, __FILE__, __LINE__, column);
+ * return boilerplate::ThrowError(cx, message, __FILE__, __LINE__, column);
+ *
+ * boilerplate::ThrowError() creates the Error object with JS::CreateError().
+ * By default it captures the whole stack, like JS_ReportError; an embedding
+ * that throws often can capture less (see 'error_policy.cpp').
  */
-static bool ThrowError(JSContext* cx, JS::HandleObject global,
-                       const char* message, const char* filename,
-                       int32_t lineno, int32_t colno = 0) {
-  JS::RootedString messageStr(cx, JS_NewStringCopyZ(cx, message));
-  if (!messageStr) return false;
-  JS::RootedString filenameStr(cx, JS_NewStringCopyZ(cx, filename));
-  if (!filenameStr) return false;
-
-  JS::Rooted<JSObject*> stack(cx);
-  if (!JS::CaptureCurrentStack(cx, &stack)) {
-      return false;
-  }
-
-  JS::Rooted<JS::Value> exc(cx);
-  if (!JS::CreateError(cx, JSEXN_ERR, stack, filenameStr, lineno, colno,
-                       nullptr, messageStr, JS::NothingHandleValue, &exc)) {
-      return false;
-  }
-
-  JS_SetPendingException(cx, exc);
-  return false;
-}
-
-#define THROW_ERROR(cx, global, message) \
-    ThrowError(cx, global, message, __FILE__, __LINE__)
+#define THROW_ERROR(cx, message) \
+    boilerplate::ThrowError(cx, message, __FILE__, __LINE__)
 
 ///// `catch` //////////////////////////////////////////////////////////////////
 
@@ -495,6 +502,11 @@ finally_block:
  * In cases where it is certain that y is an object (that is, not a boolean,
  * number, string, null, or undefined), this is fairly straightforward. Use
  * JS::Value::toObject() to cast y to type JSObject*.
+ *
+ * JS_GetProperty takes the name as a C string, and has to atomize it on every
+ * call. Code that gets the same property often can atomize the name once
+ * instead, and use JS_GetPropertyById. The examples do this with a table of
+ * pinned keys from 'property_keys.h', which boilerplate::GetProperty uses:
  */
 static bool GetProperty(JSContext* cx, JS::HandleValue y) {
   JS::RootedValue x(cx);
@@ -503,6 +515,10 @@ static bool GetProperty(JSContext* cx, JS::HandleValue y) {
   JS::RootedObject yobj(cx, &y.toObject());
   if (!JS_GetProperty(cx, yobj, "myprop", &x)) return false;
 
+  // The same, with a pre-atomized key.
+  if (!boilerplate::GetProperty(cx, yobj, boilerplate::Key::myprop, &x))
+    return false;
+
   return true;
 }
 
@@ -672,8 +688,18 @@ static bool DefineReadOnlyProperty(JSContext* cx, JS::HandleObject obj) {
  */
 static bool GetMD5Func(JSContext* cx, unsigned argc, JS::Value* vp) {
   JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
-  // Implement your MD5 hashing here...
-  JSString* hashstr = JS_NewStringCopyZ(cx, "d41d8cd98f00b204e9800998ecf8427e");
+  JS::RootedString str(cx, JS::ToString(cx, args.thisv()));
+  if (!str) return false;
+
+  // The string is hashed as UTF-8, like md5sum(1) would hash a file with the
+  // same text. See 'content_hash.cpp' for SHA-256 and xxHash as well.
+  boilerplate::HexDigest digest;
+  if (!boilerplate::HashString(cx, str, boilerplate::HashAlgorithm::MD5,
+                               &digest)) {
+    return false;
+  }
+
+  JSString* hashstr = JS_NewStringCopyN(cx, digest.chars, digest.length);
   if (!hashstr) return false;
   args.rval().setString(hashstr);
   return true;
@@ -683,15 +709,17 @@ static bool ModifyStringPrototype(JSContext* cx, JS::HandleObject global) {
   JS::RootedValue val(cx);
 
   // Get the String constructor from the global object.
-  if (!JS_GetProperty(cx, global, "String", &val)) return false;
+  if (!boilerplate::GetProperty(cx, global, boilerplate::Key::String, &val))
+    return false;
   if (val.isPrimitive())
-    return THROW_ERROR(cx, global, "String is not an object");
+    return THROW_ERROR(cx, "String is not an object");
   JS::RootedObject string(cx, &val.toObject());
 
   // Get String.prototype.
-  if (!JS_GetProperty(cx, string, "prototype", &val)) return false;
+  if (!boilerplate::GetProperty(cx, string, boilerplate::Key::prototype, &val))
+    return false;
   if (val.isPrimitive())
-    return THROW_ERROR(cx, global, "String.prototype is not an object");
+    return THROW_ERROR(cx, "String.prototype is not an object");
   JS::RootedObject string_prototype(cx, &val.toObject());
 
   // ...and now we can add some new functionality to all strings.
@@ -705,140 +733,9 @@ static bool ModifyStringPrototype(JSContext* cx, JS::HandleObject global) {
 
 /**** Defining classes ********************************************************/
 
-/* This defines a constructor function, a prototype object, and properties of
- * the prototype and of the constructor, all with one API call.
- *
- * Initialize a class by defining its constructor function, prototype, and
- * per-instance and per-class properties.
- * The latter are called "static" below by analogy to Java.
- * They are defined in the constructor object's scope, so that
- * `MyClass.myStaticProp` works along with `new MyClass()`.
- *
- * `JS_InitClass` takes a lot of arguments, but you can pass `nullptr` for
- * any of the last four if there are no such properties or methods.
- *
- * Note that you do not need to call `JS_InitClass` to make a new instance
- * of that class—otherwise there would be a chicken-and-egg problem making
- * the global object—but you should call `JS_InitClass` if you require a
- * constructor function for script authors to call via `new`, and/or a
- * class prototype object (`MyClass.prototype`) for authors to extend with
- * new properties at run time.
- * In general, if you want to support multiple instances that share
- * behavior, use `JS_InitClass`.
- *
- * // JavaScript:
- * class MyClass {
- *     constructor(a, b) {
- *         this._a = a;
- *         this._b = b;
- *     }
- *     get prop() { return 42; }
- *     method() { return this.a + this.b; }
- *     static get static_prop() { return 'static'; }
- *     static static_method(a, b) { return a + b; }
- * }
+/* The class recipes are in 'cookbook_classes.cpp', so that 'bench.cpp' can
+ * measure the same code.
  */
-static JSClass myClass = {"MyClass", JSCLASS_HAS_RESERVED_SLOTS(2), nullptr};
-
-enum MyClassSlots { SlotA, SlotB };
-
-static bool MyClassPropGetter(JSContext* cx, unsigned argc, JS::Value* vp) {
-  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
-  args.rval().setInt32(42);
-  return true;
-}
-
-static bool MyClassMethod(JSContext* cx, unsigned argc, JS::Value* vp) {
-  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
-  JS::RootedObject thisObj(cx);
-  if (!args.computeThis(cx, &thisObj)) return false;
-
-  JS::RootedValue v_a(cx, JS::GetReservedSlot(thisObj, SlotA));
-  JS::RootedValue v_b(cx, JS::GetReservedSlot(thisObj, SlotB));
-
-  double a, b;
-  if (!JS::ToNumber(cx, v_a, &a) || !JS::ToNumber(cx, v_b, &b)) return false;
-
-  args.rval().setDouble(a + b);
-  return true;
-}
-
-static bool MyClassStaticPropGetter(JSContext* cx, unsigned argc,
-                                    JS::Value* vp) {
-  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
-  JSString* str = JS_NewStringCopyZ(cx, "static");
-  if (!str) return false;
-  args.rval().setString(str);
-  return true;
-}
-
-static bool MyClassStaticMethod(JSContext* cx, unsigned argc, JS::Value* vp) {
-  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
-  if (!args.requireAtLeast(cx, "static_method", 2)) return false;
-
-  double a, b;
-  if (!JS::ToNumber(cx, args[0], &a) || !JS::ToNumber(cx, args[1], &b))
-    return false;
-
-  args.rval().setDouble(a + b);
-  return true;
-}
-
-static JSPropertySpec MyClassProperties[] = {
-    JS_PSG("prop", MyClassPropGetter, JSPROP_ENUMERATE), JS_PS_END};
-
-static JSFunctionSpec MyClassMethods[] = {
-    JS_FN("method", MyClassMethod, 0, JSPROP_ENUMERATE), JS_FS_END};
-
-static JSPropertySpec MyClassStaticProperties[] = {
-    JS_PSG("static_prop", MyClassStaticPropGetter, JSPROP_ENUMERATE),
-    JS_PS_END};
-
-static JSFunctionSpec MyClassStaticMethods[] = {
-    JS_FN("static_method", MyClassStaticMethod, 2, JSPROP_ENUMERATE),
-    JS_FS_END};
-
-static bool MyClassConstructor(JSContext* cx, unsigned argc, JS::Value* vp) {
-  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
-  if (!args.requireAtLeast(cx, "MyClass", 2)) return false;
-  if (!args.isConstructing()) {
-    JS_ReportErrorASCII(cx, "You must call this constructor with 'new'");
-    return false;
-  }
-  JS::RootedObject thisObj(cx, JS_NewObjectForConstructor(cx, &myClass, args));
-  if (!thisObj) return false;
-
-  // Slightly different from the 'private' properties in the JS example, here
-  // we use reserved slots to store the a and b values. These are not accessible
-  // from JavaScript.
-  JS::SetReservedSlot(thisObj, SlotA, args[0]);
-  JS::SetReservedSlot(thisObj, SlotB, args[1]);
-
-  args.rval().setObject(*thisObj);
-  return true;
-}
-
-static bool DefineMyClass(JSContext* cx, JS::HandleObject global) {
-  JS::RootedObject protoObj(
-      cx, JS_InitClass(cx, global, nullptr, nullptr, myClass.name,
-                       // native constructor function and min arg count
-                       MyClassConstructor, 2,
-
-                       // prototype object properties and methods -- these will
-                       // be "inherited" by all instances through delegation up
-                       // the instance's prototype link.
-                       MyClassProperties, MyClassMethods,
-
-                       // class constructor properties and methods
-                       MyClassStaticProperties, MyClassStaticMethods));
-  if (!protoObj) return false;
-
-  // You can add anything else here to protoObj (which is available as
-  // MyClass.prototype in JavaScript). For example, call JS_DefineProperty() to
-  // add data properties to the prototype.
-
-  return true;
-}
 
 /**** WANTED ******************************************************************/
 
@@ -856,15 +753,12 @@ static bool GenericJSNative(JSContext* cx, unsigned argc, JS::Value* vp) {
 }
 
 static bool ThrowJSNative(JSContext* cx, unsigned argc, JS::Value* vp) {
-  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
-  JS::RootedObject global(cx, JS::GetNonCCWObjectGlobal(&args.callee()));
-  if (!global) return false;
-  return THROW_ERROR(cx, global, "Error message");
+  return THROW_ERROR(cx, "Error message");
 }
 
 static JSFunctionSpec globalFunctions[] = {
     JS_FN("findGlobalObject", FindGlobalObject, 0, 0),
-    JS_FN("Person", PersonConstructor, 2, JSFUN_CONSTRUCTOR),
+    JS_FN("Person", cookbook::PersonConstructor, 2, JSFUN_CONSTRUCTOR),
     JS_FN("foo", GenericJSNative, 0, 0),
     JS_FN("returnInteger", ReturnInteger, 0, 0),
     JS_FN("returnFloat", ReturnFloat, 0, 0),
@@ -882,7 +776,7 @@ static bool ExecuteCode(JSContext* cx, const char* code) {
   }
 
   JS::RootedValue unused(cx);
-  return JS::Evaluate(cx, options, source, &unused);
+  return boilerplate::EvaluateCached(cx, options, source, &unused);
 }
 
 class AutoReportException {
@@ -918,6 +812,9 @@ static bool RunCookbook(JSContext* cx) {
 
   JSAutoRealm ar(cx, global);
 
+  // Atomize the property names used by the recipes; see "Getting a property".
+  if (!boilerplate::InitPropertyKeys(cx)) return false;
+
   // Define some helper methods on our new global.
   if (!JS_DefineFunctions(cx, global, globalFunctions)) return false;
 
@@ -931,7 +828,8 @@ static bool RunCookbook(JSContext* cx) {
 
   if (!DefineGlobalFunction(cx, global) || !CreateArray(cx) ||
       !CreateObject(cx) || !ConstructObjectWithNew(cx, global) ||
-      !CallGlobalFunction(cx, global)) {
+      !CallGlobalFunction(cx, global) ||
+      !CallGlobalFunctionRepeatedly(cx, global)) {
     return false;
   }
 
@@ -949,7 +847,7 @@ static bool RunCookbook(JSContext* cx) {
   if (ThrowValue(cx, exc)) return false;
   JS_ClearPendingException(cx);
 
-  if (THROW_ERROR(cx, global, "an error message")) return false;
+  if (THROW_ERROR(cx, "an error message")) return false;
   JS_ClearPendingException(cx);
 
   if (!CatchError(cx, global)) return false;
@@ -972,8 +870,11 @@ static bool RunCookbook(JSContext* cx) {
   if (!DefineGetterSetterProperty(cx, obj)) return false;
   if (!DefineReadOnlyProperty(cx, obj)) return false;
   if (!ModifyStringPrototype(cx, global)) return false;
+  // The full set of hash getters, which replaces md5sum with an equivalent one,
+  // and a contentHash() function for binary data as well.
+  if (!boilerplate::DefineContentHashing(cx, global)) return false;
 
-  if (!DefineMyClass(cx, global)) return false;
+  if (!cookbook::DefineMyClass(cx, global)) return false;
   if (!ExecuteCode(cx, R"js(
         const m = new MyClass(1, 2);
         m.method();
@@ -983,14 +884,37 @@ static bool RunCookbook(JSContext* cx) {
       )js"))
     return false;
 
+  if (!cookbook::DefineMyJitClass(cx, global)) return false;
+  if (!ExecuteCode(cx, R"js(
+        const j = new MyJitClass(1, 2);
+        let sum = 0;
+        for (let i = 0; i < 10000; i++) sum += j.prop + j.method();
+      )js"))
+    return false;
+
+  if (!cookbook::DefineMyNativeClass(cx, global)) return false;
+  if (!ExecuteCode(cx, R"js(
+        const n = new MyNativeClass(1, 2);
+        n.a = 5;
+        n.method();
+      )js"))
+    return false;
+
   // Also execute each of the JSNative functions we defined:
-  return ExecuteCode(cx, R"js(
+  bool ok = ExecuteCode(cx, R"js(
     justForFun();
     findGlobalObject();
     returnInteger();
     returnFloat();
-    ''.md5sum
+    ''.md5sum;
+    'text'.sha256sum;
+    contentHash(new Uint8Array([1, 2, 3]), 'xxh64');
   )js");
+
+  // The context is destroyed after this.
+  boilerplate::ResetPropertyKeys(cx);
+  boilerplate::ResetContentHashing(cx);
+  return ok;
 }
 
 int main(int argc, const char* argv[]) {
@@ -0,0 +1,387 @@
+#include <jsapi.h>
+#include <jsfriendapi.h>
+#include <js/CallArgs.h>
+#include <js/Conversions.h>
+#include <js/Object.h>
+#include <js/PropertySpec.h>
+#include <js/experimental/JitInfo.h>
+
+#include "cookbook_classes.h"
+#include "native_class.h"
+
+// The class recipes from 'cookbook.cpp'. They live in their own file so that
+// 'bench.cpp' can define and measure the very same classes.
+
+///// Constructing an object with new //////////////////////////////////////////
+
+// The native constructor behind `new Person("Dave", 24)` in the cookbook's
+// recipe. It ignores its arguments and returns a plain object.
+bool cookbook::PersonConstructor(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  JS::RootedObject newObject(cx, JS_NewPlainObject(cx));
+  if (!newObject) return false;
+  args.rval().setObject(*newObject);
+  return true;
+}
+
+/**** Defining classes ********************************************************/
+
+/* This defines a constructor function, a prototype object, and properties of
+ * the prototype and of the constructor, all with one API call.
+ *
+ * Initialize a class by defining its constructor function, prototype, and
+ * per-instance and per-class properties.
+ * The latter are called "static" below by analogy to Java.
+ * They are defined in the constructor object's scope, so that
+ * `MyClass.myStaticProp` works along with `new MyClass()`.
+ *
+ * `JS_InitClass` takes a lot of arguments, but you can pass `nullptr` for
+ * any of the last four if there are no such properties or methods.
+ *
+ * Note that you do not need to call `JS_InitClass` to make a new instance
+ * of that class—otherwise there would be a chicken-and-egg problem making
+ * the global object—but you should call `JS_InitClass` if you require a
+ * constructor function for script authors to call via `new`, and/or a
+ * class prototype object (`MyClass.prototype`) for authors to extend with
+ * new properties at run time.
+ * In general, if you want to support multiple instances that share
+ * behavior, use `JS_InitClass`.
+ *
+ * // JavaScript:
+ * class MyClass {
+ *     constructor(a, b) {
+ *         this._a = a;
+ *         this._b = b;
+ *     }
+ *     get prop() { return 42; }
+ *     method() { return this.a + this.b; }
+ *     static get static_prop() { return 'static'; }
+ *     static static_method(a, b) { return a + b; }
+ * }
+ */
+static JSClass myClass = {"MyClass", JSCLASS_HAS_RESERVED_SLOTS(2), nullptr};
+
+enum MyClassSlots { SlotA, SlotB };
+
+static bool MyClassPropGetter(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  args.rval().setInt32(42);
+  return true;
+}
+
+static bool MyClassMethod(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  JS::RootedObject thisObj(cx);
+  if (!args.computeThis(cx, &thisObj)) return false;
+
+  JS::RootedValue v_a(cx, JS::GetReservedSlot(thisObj, SlotA));
+  JS::RootedValue v_b(cx, JS::GetReservedSlot(thisObj, SlotB));
+
+  double a, b;
+  if (!JS::ToNumber(cx, v_a, &a) || !JS::ToNumber(cx, v_b, &b)) return false;
+
+  args.rval().setDouble(a + b);
+  return true;
+}
+
+static bool MyClassStaticPropGetter(JSContext* cx, unsigned argc,
+                                    JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  JSString* str = JS_NewStringCopyZ(cx, "static");
+  if (!str) return false;
+  args.rval().setString(str);
+  return true;
+}
+
+static bool MyClassStaticMethod(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  if (!args.requireAtLeast(cx, "static_method", 2)) return false;
+
+  double a, b;
+  if (!JS::ToNumber(cx, args[0], &a) || !JS::ToNumber(cx, args[1], &b))
+    return false;
+
+  args.rval().setDouble(a + b);
+  return true;
+}
+
+static JSPropertySpec MyClassProperties[] = {
+    JS_PSG("prop", MyClassPropGetter, JSPROP_ENUMERATE), JS_PS_END};
+
+static JSFunctionSpec MyClassMethods[] = {
+    JS_FN("method", MyClassMethod, 0, JSPROP_ENUMERATE), JS_FS_END};
+
+static JSPropertySpec MyClassStaticProperties[] = {
+    JS_PSG("static_prop", MyClassStaticPropGetter, JSPROP_ENUMERATE),
+    JS_PS_END};
+
+static JSFunctionSpec MyClassStaticMethods[] = {
+    JS_FN("static_method", MyClassStaticMethod, 2, JSPROP_ENUMERATE),
+    JS_FS_END};
+
+static bool MyClassConstructor(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  if (!args.requireAtLeast(cx, "MyClass", 2)) return false;
+  if (!args.isConstructing()) {
+    JS_ReportErrorASCII(cx, "You must call this constructor with 'new'");
+    return false;
+  }
+  JS::RootedObject thisObj(cx, JS_NewObjectForConstructor(cx, &myClass, args));
+  if (!thisObj) return false;
+
+  // Slightly different from the 'private' properties in the JS example, here
+  // we use reserved slots to store the a and b values. These are not accessible
+  // from JavaScript.
+  JS::SetReservedSlot(thisObj, SlotA, args[0]);
+  JS::SetReservedSlot(thisObj, SlotB, args[1]);
+
+  args.rval().setObject(*thisObj);
+  return true;
+}
+
+bool cookbook::DefineMyClass(JSContext* cx, JS::HandleObject global) {
+  JS::RootedObject protoObj(
+      cx, JS_InitClass(cx, global, nullptr, nullptr, myClass.name,
+                       // native constructor function and min arg count
+                       MyClassConstructor, 2,
+
+                       // prototype object properties and methods -- these will
+                       // be "inherited" by all instances through delegation up
+                       // the instance's prototype link.
+                       MyClassProperties, MyClassMethods,
+
+                       // class constructor properties and methods
+                       MyClassStaticProperties, MyClassStaticMethods));
+  if (!protoObj) return false;
+
+  // You can add anything else here to protoObj (which is available as
+  // MyClass.prototype in JavaScript). For example, call JS_DefineProperty() to
+  // add data properties to the prototype.
+
+  return true;
+}
+
+///// Defining a class with JIT-inlinable accessors ////////////////////////////
+
+/* The getter and method of MyClass above are ordinary JSNatives, so the JIT
+ * has to treat every call to them as an opaque call that could do anything.
+ * Firefox's DOM bindings avoid this by describing each native with a
+ * JSJitInfo: which C++ function to call directly from JIT code, what type it
+ * returns, whether it can fail, and what state it reads. With that, Ion can
+ * call the function without going through a JSNative, and can hoist or
+ * eliminate calls that only read immutable state.
+ *
+ * The JIT only does this for classes that look like DOM classes:
+ * - the class has the JSCLASS_IS_DOMJSCLASS flag;
+ * - reserved slot 0 holds a private pointer to the C++ object, which is passed
+ *   to the JIT-callable functions as `self`;
+ * - js::SetDOMCallbacks() is given a function that checks that an instance's
+ *   class matches the JSJitInfo's protoID and depth, which here simply
+ *   identify MyJitClass.
+ *
+ * The JSNatives are still needed, for the interpreter and for calls that the
+ * JIT can't optimize. They unwrap `this` and call the same functions.
+ *
+ * This class behaves like MyClass, except that a and b are converted to
+ * numbers once, in the constructor.
+ */
+struct MyJitClassData {
+  double a;
+  double b;
+};
+
+enum MyJitClassSlots { MyJitClassDataSlot, MyJitClassSlotCount };
+
+enum { MyJitClassProtoID = 1 };
+
+static void MyJitClassFinalize(JS::GCContext* gcx, JSObject* obj) {
+  delete JS::GetMaybePtrFromReservedSlot<MyJitClassData>(obj,
+                                                         MyJitClassDataSlot);
+}
+
+static const JSClassOps myJitClassOps = {
+    nullptr,  // addProperty
+    nullptr,  // deleteProperty
+    nullptr,  // enumerate
+    nullptr,  // newEnumerate
+    nullptr,  // resolve
+    nullptr,  // mayResolve
+    MyJitClassFinalize,
+    nullptr,  // call
+    nullptr,  // construct
+    nullptr,  // trace
+};
+
+static const JSClass myJitClass = {
+    "MyJitClass",
+    JSCLASS_IS_DOMJSCLASS | JSCLASS_HAS_RESERVED_SLOTS(MyJitClassSlotCount) |
+        JSCLASS_BACKGROUND_FINALIZE,
+    &myJitClassOps};
+
+static bool MyJitClassMatchesProto(const JSClass* instanceClass,
+                                   uint32_t protoID, uint32_t depth) {
+  return instanceClass == &myJitClass && protoID == MyJitClassProtoID &&
+         depth == 0;
+}
+
+static const js::DOMCallbacks myJitClassDOMCallbacks = {
+    MyJitClassMatchesProto};
+
+// The functions that JIT code calls directly.
+
+static bool MyJitClassGetProp(JSContext* cx, JS::HandleObject thisObj,
+                              void* self, JSJitGetterCallArgs args) {
+  args.rval().setInt32(42);
+  return true;
+}
+
+static bool MyJitClassCallMethod(JSContext* cx, JS::HandleObject thisObj,
+                                 void* self, const JSJitMethodCallArgs& args) {
+  auto* data = static_cast<MyJitClassData*>(self);
+  args.rval().setDouble(data->a + data->b);
+  return true;
+}
+
+static const JSJitInfo MyJitClassPropInfo = {
+    {.getter = MyJitClassGetProp},
+    {MyJitClassProtoID},
+    {0},  // depth
+    JSJitInfo::Getter,
+    JSJitInfo::AliasNone,  // reads no mutable state
+    JSVAL_TYPE_INT32,
+    true,   // isInfallible
+    true,   // isMovable
+    true,   // isEliminatable
+    false,  // isAlwaysInSlot
+    false,  // isLazilyCachedInSlot
+    false,  // isTypedMethod
+    0,      // slotIndex
+};
+
+static const JSJitInfo MyJitClassMethodInfo = {
+    {.method = MyJitClassCallMethod},
+    {MyJitClassProtoID},
+    {0},  // depth
+    JSJitInfo::Method,
+    JSJitInfo::AliasNone,  // a and b never change
+    JSVAL_TYPE_DOUBLE,
+    true,   // isInfallible
+    true,   // isMovable
+    true,   // isEliminatable
+    false,  // isAlwaysInSlot
+    false,  // isLazilyCachedInSlot
+    false,  // isTypedMethod
+    0,      // slotIndex
+};
+
+// The JSNatives, which check `this` before calling the functions above.
+
+static MyJitClassData* UnwrapMyJitClass(JSContext* cx, JS::CallArgs& args,
+                                        JS::MutableHandleObject thisObj) {
+  if (!args.computeThis(cx, thisObj)) return nullptr;
+  if (!JS_InstanceOf(cx, thisObj, &myJitClass, &args)) return nullptr;
+
+  auto* data = JS::GetMaybePtrFromReservedSlot<MyJitClassData>(
+      thisObj, MyJitClassDataSlot);
+  if (!data) JS_ReportErrorASCII(cx, "MyJitClass object is not initialized");
+  return data;
+}
+
+static bool MyJitClassPropGetter(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  JS::RootedObject thisObj(cx);
+  MyJitClassData* data = UnwrapMyJitClass(cx, args, &thisObj);
+  if (!data) return false;
+  return MyJitClassGetProp(cx, thisObj, data, JSJitGetterCallArgs(args));
+}
+
+static bool MyJitClassMethod(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  JS::RootedObject thisObj(cx);
+  MyJitClassData* data = UnwrapMyJitClass(cx, args, &thisObj);
+  if (!data) return false;
+  return MyJitClassCallMethod(cx, thisObj, data, JSJitMethodCallArgs(args));
+}
+
+static JSPropertySpec MyJitClassProperties[] = {
+    JSPropertySpec::nativeAccessors("prop", JSPROP_ENUMERATE,
+                                    MyJitClassPropGetter, &MyJitClassPropInfo),
+    JS_PS_END};
+
+static JSFunctionSpec MyJitClassMethods[] = {
+    JS_FNINFO("method", MyJitClassMethod, &MyJitClassMethodInfo, 0,
+              JSPROP_ENUMERATE),
+    JS_FS_END};
+
+static bool MyJitClassConstructor(JSContext* cx, unsigned argc,
+                                  JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  if (!args.requireAtLeast(cx, "MyJitClass", 2)) return false;
+  if (!args.isConstructing()) {
+    JS_ReportErrorASCII(cx, "You must call this constructor with 'new'");
+    return false;
+  }
+
+  double a, b;
+  if (!JS::ToNumber(cx, args[0], &a) || !JS::ToNumber(cx, args[1], &b))
+    return false;
+
+  JS::RootedObject thisObj(cx,
+                           JS_NewObjectForConstructor(cx, &myJitClass, args));
+  if (!thisObj) return false;
+
+  JS::SetReservedSlot(thisObj, MyJitClassDataSlot,
+                      JS::PrivateValue(new MyJitClassData{a, b}));
+
+  args.rval().setObject(*thisObj);
+  return true;
+}
+
+bool cookbook::DefineMyJitClass(JSContext* cx, JS::HandleObject global) {
+  // The DOM callbacks are per runtime. A real embedding with several such
+  // classes would give each one its own protoID, and check them all here.
+  js::SetDOMCallbacks(cx, &myJitClassDOMCallbacks);
+
+  JS::RootedObject protoObj(
+      cx, JS_InitClass(cx, global, nullptr, nullptr, myJitClass.name,
+                       MyJitClassConstructor, 2, MyJitClassProperties,
+                       MyJitClassMethods, nullptr, nullptr));
+  if (!protoObj) return false;
+
+  return true;
+}
+
+///// Defining a class backed by a C++ struct ////////////////////////////////
+
+/* MyClass keeps its state in reserved slots as JS values, and converts them
+ * on every call. A C++ object stored in a reserved slot, like MyJitClass and
+ * the Crc class in 'resolve.cpp', avoids that, but needs its own constructor,
+ * finalizer and an unwrapping JSNative for every property and method.
+ * boilerplate::NativeClass generates all of those from a list of the struct's
+ * fields and methods, and allocates the structs from a pool instead of with
+ * `new` (see 'native_class.h').
+ *
+ * // JavaScript:
+ * class MyNativeClass {
+ *     constructor(a, b) {
+ *         this.a = Number(a);
+ *         this.b = Number(b);
+ *     }
+ *     method() { return this.a + this.b; }
+ * }
+ *
+ * The struct, MyNativeClassData, is declared in 'cookbook_classes.h' so that
+ * 'bench.cpp' can use it as well.
+ */
+using cookbook::MyNativeClassData;
+
+const JSPropertySpec MyNativeClassData::properties[] = {
+    boilerplate::FieldSpec<&MyNativeClassData::a>("a"),
+    boilerplate::FieldSpec<&MyNativeClassData::b>("b"), JS_PS_END};
+
+const JSFunctionSpec MyNativeClassData::methods[] = {
+    boilerplate::MethodSpec<&MyNativeClassData::method>("method"), JS_FS_END};
+
+bool cookbook::DefineMyNativeClass(JSContext* cx, JS::HandleObject global) {
+  return !!boilerplate::NativeClass<MyNativeClassData>::Define(cx, global);
+}
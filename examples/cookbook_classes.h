@@ -0,0 +1,34 @@
+#pragma once
+
+#include <tuple>
+
+#include <jsapi.h>
+#include <js/PropertySpec.h>
+
+// See 'cookbook_classes.cpp' for documentation.
+
+namespace cookbook {
+
+bool PersonConstructor(JSContext* cx, unsigned argc, JS::Value* vp);
+
+bool DefineMyClass(JSContext* cx, JS::HandleObject global);
+bool DefineMyJitClass(JSContext* cx, JS::HandleObject global);
+
+// The struct behind MyNativeClass, for boilerplate::NativeClass.
+struct MyNativeClassData {
+  double a;
+  double b;
+
+  MyNativeClassData(double a_, double b_) : a(a_), b(b_) {}
+
+  double method() const { return a + b; }
+
+  static constexpr const char* className = "MyNativeClass";
+  using ConstructorArgs = std::tuple<double, double>;
+  static const JSPropertySpec properties[];
+  static const JSFunctionSpec methods[];
+};
+
+bool DefineMyNativeClass(JSContext* cx, JS::HandleObject global);
+
+}  // namespace cookbook
@@ -0,0 +1,125 @@
+#include <chrono>
+#include <cinttypes>
+
+#include <jsapi.h>
+#include <js/Exception.h>
+#include <js/Stack.h>
+
+#include "error_policy.h"
+
+// Cheaper Error objects for code that throws often, such as validation that
+// fails fast on bad input.
+//
+// Creating an Error with a stack means calling JS::CaptureCurrentStack(), which
+// allocates a SavedFrame object for every frame on the stack that isn't cached
+// from an earlier capture. With a deep stack, that costs far more than creating
+// the Error itself. Formatting the frames into the `stack` string is already
+// deferred until script reads it, but the frames have to be captured when the
+// error is thrown, since they are gone once the stack unwinds.
+//
+// The default policy captures the whole stack, as the engine does. An embedding
+// that throws often can opt in to capturing less: at most maxFrames frames (the
+// ones nearest the throw, which are usually the interesting ones), or no stack
+// at all. Since a short stack can hide where errors come from,
+// fullStackInterval can then be set to capture the whole stack for a sample of
+// the errors.
+//
+// The policy and the counters are per thread, since there is one context per
+// thread. The counters are atomic, so that another thread can read them.
+
+using Clock = std::chrono::steady_clock;
+
+static thread_local boilerplate::ErrorPolicy errorPolicy;
+static thread_local boilerplate::ErrorStats errorStats;
+
+void boilerplate::ErrorStats::reset() {
+  errors = 0;
+  stacksCaptured = 0;
+  fullStacks = 0;
+  captureNanoseconds = 0;
+  maxCaptureNanoseconds = 0;
+}
+
+void boilerplate::ErrorStats::print(FILE* out) const {
+  uint64_t captured = stacksCaptured.load();
+  uint64_t nanos = captureNanoseconds.load();
+  fprintf(out,
+          "Errors: %" PRIu64 " thrown, %" PRIu64 " stacks captured (%" PRIu64
+          " full)\n  capture time: total %" PRIu64 " ns, mean %" PRIu64
+          " ns, max %" PRIu64 " ns\n",
+          errors.load(), captured, fullStacks.load(), nanos,
+          captured ? nanos / captured : 0, maxCaptureNanoseconds.load());
+}
+
+// Set the policy for errors thrown on the calling thread.
+void boilerplate::SetErrorPolicy(const ErrorPolicy& policy) {
+  errorPolicy = policy;
+}
+
+const boilerplate::ErrorPolicy& boilerplate::GetErrorPolicy() {
+  return errorPolicy;
+}
+
+// The counters for the calling thread. The pointer stays valid until the
+// thread exits.
+boilerplate::ErrorStats* boilerplate::GetErrorStats() { return &errorStats; }
+
+// Capture the current stack as allowed by the policy, for passing to
+// JS::CreateError(). Sets stack to null if the policy captures no stack.
+bool boilerplate::CaptureErrorStack(JSContext* cx,
+                                    JS::MutableHandleObject stack) {
+  ErrorStats& stats = errorStats;
+  uint64_t count = stats.errors.fetch_add(1, std::memory_order_relaxed) + 1;
+
+  bool full = errorPolicy.maxFrames == ErrorPolicy::AllFrames ||
+              (errorPolicy.fullStackInterval &&
+               count % errorPolicy.fullStackInterval == 0);
+  if (!full && errorPolicy.maxFrames == 0) {
+    stack.set(nullptr);
+    return true;
+  }
+
+  Clock::time_point start = Clock::now();
+  bool ok = full ? JS::CaptureCurrentStack(cx, stack)
+                 : JS::CaptureCurrentStack(
+                       cx, stack, JS::StackCapture(JS::MaxFrames(
+                                      errorPolicy.maxFrames)));
+  uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       Clock::now() - start)
+                       .count();
+  if (!ok) return false;
+
+  stats.stacksCaptured.fetch_add(1, std::memory_order_relaxed);
+  if (full) stats.fullStacks.fetch_add(1, std::memory_order_relaxed);
+  stats.captureNanoseconds.fetch_add(nanos, std::memory_order_relaxed);
+
+  uint64_t max = stats.maxCaptureNanoseconds.load(std::memory_order_relaxed);
+  while (nanos > max && !stats.maxCaptureNanoseconds.compare_exchange_weak(
+                            max, nanos, std::memory_order_relaxed)) {
+  }
+  return true;
+}
+
+// Throw an Error with the given message and location, and a stack captured
+// according to the policy. Always returns false, so that a JSNative can
+// `return ThrowError(...)`.
+bool boilerplate::ThrowError(JSContext* cx, const char* message,
+                             const char* filename, uint32_t lineno,
+                             uint32_t colno) {
+  JS::RootedString messageStr(cx, JS_NewStringCopyZ(cx, message));
+  if (!messageStr) return false;
+  JS::RootedString filenameStr(cx, JS_NewStringCopyZ(cx, filename));
+  if (!filenameStr) return false;
+
+  JS::RootedObject stack(cx);
+  if (!CaptureErrorStack(cx, &stack)) return false;
+
+  JS::RootedValue exc(cx);
+  if (!JS::CreateError(cx, JSEXN_ERR, stack, filenameStr, lineno, colno,
+                       nullptr, messageStr, JS::NothingHandleValue, &exc)) {
+    return false;
+  }
+
+  JS_SetPendingException(cx, exc);
+  return false;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+#include <jsapi.h>
+
+// See 'error_policy.cpp' for documentation.
+
+namespace boilerplate {
+
+struct ErrorPolicy {
+  static constexpr uint32_t AllFrames = UINT32_MAX;
+
+  // Most frames to capture for an error's stack. 0 captures no stack at all;
+  // the default captures the whole stack, like JS_ReportError does.
+  uint32_t maxFrames = AllFrames;
+  // Capture the whole stack for one in every this many errors, as a sample of
+  // where errors come from. 0 never does.
+  uint32_t fullStackInterval = 0;
+};
+
+struct ErrorStats {
+  std::atomic<uint64_t> errors{0};
+  std::atomic<uint64_t> stacksCaptured{0};
+  std::atomic<uint64_t> fullStacks{0};
+  std::atomic<uint64_t> captureNanoseconds{0};
+  std::atomic<uint64_t> maxCaptureNanoseconds{0};
+
+  void reset();
+  void print(FILE* out) const;
+};
+
+void SetErrorPolicy(const ErrorPolicy& policy);
+const ErrorPolicy& GetErrorPolicy();
+ErrorStats* GetErrorStats();
+
+bool CaptureErrorStack(JSContext* cx, JS::MutableHandleObject stack);
+
+bool ThrowError(JSContext* cx, const char* message, const char* filename,
+                uint32_t lineno, uint32_t colno = 0);
+
+}  // namespace boilerplate
@@ -0,0 +1,232 @@
+#include <cinttypes>
+#include <cstring>
+#include <tuple>
+
+#include <jsapi.h>
+#include <js/ErrorReport.h>
+#include <js/Exception.h>
+#include <js/SavedFrameAPI.h>
+#include <mozilla/Maybe.h>
+#include <mozilla/Span.h>
+#include <mozilla/Unused.h>
+
+#include "exception_log.h"
+
+// A cheap, non-fatal alternative to boilerplate::ReportAndClearException(), for
+// embeddings where scripts throw (and expect to throw) very often.
+//
+// ReportAndClearException() builds a full JS::ErrorReportBuilder, which may
+// call back into JavaScript to stringify the thrown value, prints the report
+// synchronously, and exits the process if anything goes wrong. That is fine for
+// an example that stops at the first error, but not for a hot path.
+//
+// ExceptionLog::capture() instead takes the pending exception and copies only
+// what's cheap to get without running any JavaScript: the message and location
+// of Error objects (or the value itself for strings and other primitives), and
+// up to CapturedException::MaxFrames frames of the stack that was saved when
+// the exception was thrown. The record goes into a ring buffer that was
+// allocated up front, and a background thread formats and prints it. If the
+// printing thread falls behind and the buffer is full, records are dropped and
+// counted instead of blocking the caller.
+//
+// Exceptions are also counted per realm. Realms are identified by pointer, so
+// call forgetRealm() when a realm is discarded.
+
+// Copy a JS string into a fixed-size buffer as UTF-8, truncating it if needed.
+// This does not allocate.
+template <size_t N>
+static void CopyString(JSContext* cx, JSString* str, char (&buf)[N]) {
+  buf[0] = '\0';
+  mozilla::Maybe<std::tuple<size_t, size_t>> result =
+      JS_EncodeStringToUTF8BufferPartial(cx, str, mozilla::Span<char>(buf, N - 1));
+  if (result) buf[std::get<1>(*result)] = '\0';
+}
+
+template <size_t N>
+static void CopyUTF8(const char* chars, char (&buf)[N]) {
+  if (!chars) chars = "";
+  snprintf(buf, N, "%s", chars);
+}
+
+static const char* DescribePrimitive(const JS::Value& v) {
+  if (v.isUndefined()) return "undefined";
+  if (v.isNull()) return "null";
+  if (v.isBoolean()) return v.toBoolean() ? "true" : "false";
+  if (v.isSymbol()) return "(symbol)";
+  if (v.isBigInt()) return "(bigint)";
+  return "(non-Error object)";
+}
+
+static void CaptureStack(JSContext* cx, JS::HandleObject stack,
+                         boilerplate::CapturedException* record) {
+  JS::RootedObject frame(cx, stack);
+  JS::RootedObject parent(cx);
+  JS::RootedString str(cx);
+  constexpr auto selfHosted = JS::SavedFrameSelfHosted::Exclude;
+
+  while (frame && record->frameCount < record->MaxFrames) {
+    boilerplate::CapturedException::Frame& f =
+        record->frames[record->frameCount++];
+    f.function[0] = '\0';
+    f.filename[0] = '\0';
+    f.line = 0;
+    f.column = 0;
+
+    if (JS::GetSavedFrameFunctionDisplayName(cx, nullptr, frame, &str,
+                                             selfHosted) ==
+            JS::SavedFrameResult::Ok &&
+        str) {
+      CopyString(cx, str, f.function);
+    }
+    if (JS::GetSavedFrameSource(cx, nullptr, frame, &str, selfHosted) ==
+            JS::SavedFrameResult::Ok &&
+        str) {
+      CopyString(cx, str, f.filename);
+    }
+    mozilla::Unused << JS::GetSavedFrameLine(cx, nullptr, frame, &f.line,
+                                             selfHosted);
+    mozilla::Unused << JS::GetSavedFrameColumn(cx, nullptr, frame, &f.column,
+                                               selfHosted);
+
+    if (JS::GetSavedFrameParent(cx, nullptr, frame, &parent, selfHosted) !=
+        JS::SavedFrameResult::Ok) {
+      break;
+    }
+    frame = parent;
+  }
+}
+
+static void PrintCapturedException(FILE* out,
+                                   const boilerplate::CapturedException& e) {
+  if (e.filename[0]) {
+    fprintf(out, "%s:%" PRIu32 ":%" PRIu32 " %s\n", e.filename, e.line,
+            e.column, e.message);
+  } else {
+    fprintf(out, "uncaught exception: %s\n", e.message);
+  }
+
+  for (uint32_t i = 0; i < e.frameCount; i++) {
+    const boilerplate::CapturedException::Frame& f = e.frames[i];
+    fprintf(out, "  at %s (%s:%" PRIu32 ":%" PRIu32 ")\n",
+            f.function[0] ? f.function : "<anonymous>", f.filename, f.line,
+            f.column);
+  }
+}
+
+boilerplate::ExceptionLog::ExceptionLog(size_t capacity, FILE* out)
+    : m_out(out),
+      m_ring(capacity > 0 ? capacity : 1),
+      m_head(0),
+      m_tail(0),
+      m_queued(0),
+      m_printing(false),
+      m_shuttingDown(false),
+      m_total(0),
+      m_dropped(0),
+      m_writer(&ExceptionLog::writerMain, this) {}
+
+// Prints whatever is still queued before returning.
+boilerplate::ExceptionLog::~ExceptionLog() {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_shuttingDown = true;
+  }
+  m_wakeup.notify_one();
+  m_writer.join();
+  fflush(m_out);
+}
+
+// Take the pending exception off the context and queue it for printing. Like
+// JS::StealPendingExceptionStack(), returns false if there was no exception
+// pending, which means an uncatchable exception (e.g. out of memory.)
+//
+// NOTE: This must be called with a JSAutoRealm (or equivalent) on the stack.
+bool boilerplate::ExceptionLog::capture(JSContext* cx) {
+  JS::ExceptionStack exnStack(cx);
+  if (!JS::StealPendingExceptionStack(cx, &exnStack)) return false;
+
+  CapturedException record;
+  record.message[0] = '\0';
+  record.filename[0] = '\0';
+  record.line = 0;
+  record.column = 0;
+  record.frameCount = 0;
+
+  JS::HandleValue exn = exnStack.exception();
+  JSErrorReport* report = nullptr;
+  if (exn.isObject()) {
+    JS::RootedObject exnObj(cx, &exn.toObject());
+    report = JS_ErrorFromException(cx, exnObj);
+  }
+
+  if (report) {
+    CopyUTF8(report->message().c_str(), record.message);
+    CopyUTF8(report->filename, record.filename);
+    record.line = report->lineno;
+    record.column = report->column;
+  } else if (exn.isString()) {
+    CopyString(cx, exn.toString(), record.message);
+  } else if (exn.isNumber()) {
+    snprintf(record.message, sizeof(record.message), "%g", exn.toNumber());
+  } else {
+    CopyUTF8(DescribePrimitive(exn), record.message);
+  }
+
+  CaptureStack(cx, exnStack.stack(), &record);
+
+  m_total++;
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_realmCounts[JS::GetCurrentRealmOrNull(cx)]++;
+
+    if (m_queued == m_ring.size()) {
+      m_dropped++;
+      return true;
+    }
+    m_ring[m_head] = record;
+    m_head = (m_head + 1) % m_ring.size();
+    m_queued++;
+  }
+  m_wakeup.notify_one();
+  return true;
+}
+
+// Wait until everything captured so far has been printed.
+void boilerplate::ExceptionLog::flush() {
+  {
+    std::unique_lock<std::mutex> guard(m_lock);
+    m_drained.wait(guard, [this] { return m_queued == 0 && !m_printing; });
+  }
+  fflush(m_out);
+}
+
+uint64_t boilerplate::ExceptionLog::countForRealm(JS::Realm* realm) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  auto entry = m_realmCounts.find(realm);
+  return entry == m_realmCounts.end() ? 0 : entry->second;
+}
+
+void boilerplate::ExceptionLog::forgetRealm(JS::Realm* realm) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_realmCounts.erase(realm);
+}
+
+void boilerplate::ExceptionLog::writerMain() {
+  std::unique_lock<std::mutex> guard(m_lock);
+  while (true) {
+    m_wakeup.wait(guard, [this] { return m_shuttingDown || m_queued > 0; });
+    if (m_queued == 0) break;
+
+    CapturedException record = m_ring[m_tail];
+    m_tail = (m_tail + 1) % m_ring.size();
+    m_queued--;
+    m_printing = true;
+
+    guard.unlock();
+    PrintCapturedException(m_out, record);
+    guard.lock();
+
+    m_printing = false;
+    if (m_queued == 0) m_drained.notify_all();
+  }
+}
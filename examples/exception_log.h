@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <jsapi.h>
+
+// See 'exception_log.cpp' for documentation.
+
+namespace boilerplate {
+
+struct CapturedException {
+  static constexpr size_t MaxFrames = 8;
+
+  struct Frame {
+    char function[64];
+    char filename[128];
+    uint32_t line;
+    uint32_t column;
+  };
+
+  char message[256];
+  char filename[128];
+  uint32_t line;
+  uint32_t column;
+  uint32_t frameCount;
+  Frame frames[MaxFrames];
+};
+
+class ExceptionLog {
+ public:
+  explicit ExceptionLog(size_t capacity = 1024, FILE* out = stderr);
+  ~ExceptionLog();
+
+  ExceptionLog(const ExceptionLog&) = delete;
+  ExceptionLog& operator=(const ExceptionLog&) = delete;
+
+  bool capture(JSContext* cx);
+  void flush();
+
+  uint64_t total() const { return m_total; }
+  uint64_t dropped() const { return m_dropped; }
+  uint64_t countForRealm(JS::Realm* realm);
+  void forgetRealm(JS::Realm* realm);
+
+ private:
+  void writerMain();
+
+  FILE* m_out;
+  std::vector<CapturedException> m_ring;
+  size_t m_head;  // next slot to write
+  size_t m_tail;  // next slot to print
+  size_t m_queued;
+
+  std::mutex m_lock;
+  std::condition_variable m_wakeup;
+  std::condition_variable m_drained;
+  std::unordered_map<JS::Realm*, uint64_t> m_realmCounts;
+  bool m_printing : 1;
+  bool m_shuttingDown : 1;
+
+  std::atomic<uint64_t> m_total;
+  std::atomic<uint64_t> m_dropped;
+
+  std::thread m_writer;
+};
+
+}  // namespace boilerplate
@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <bit>
+#include <cinttypes>
+#include <memory>
+
+#include <jsapi.h>
+#include <js/GCAPI.h>
+
+#include "gc_stats.h"
+
+// Opt-in telemetry for the garbage collector, to tell whether latency spikes
+// are caused by GC pauses.
+//
+// EnableGCStats() installs a GC callback and a GC slice callback on a context.
+// Major GCs may be incremental, split into several slices with the script
+// running in between; the slice callback is told when each slice and each
+// whole cycle starts and ends. We record the duration of every slice (the
+// pauses that script actually experiences), the duration of every cycle, the
+// reason for each GC, whether it collected all zones or only some of them, and
+// the size of the GC heap before and after.
+//
+// The numbers are kept in histograms with power-of-two buckets, updated with
+// relaxed atomic operations only, so another thread can read them at any time
+// without locking. They are available to C++ through GetGCStats(), and to
+// script through a gcStats() function defined by DefineGCStatsFunction().
+//
+// NOTE: SpiderMonkey only has one GC callback per context, so this replaces any
+// callback that was set with JS_SetGCCallback(). Slice callbacks are chained.
+
+using Clock = std::chrono::steady_clock;
+
+boilerplate::Histogram::Histogram() : m_count(0), m_sum(0), m_max(0) {
+  for (std::atomic<uint64_t>& bucket : m_buckets) bucket = 0;
+}
+
+void boilerplate::Histogram::record(uint64_t value) {
+  size_t bucket = std::bit_width(value);
+  if (bucket >= BucketCount) bucket = BucketCount - 1;
+
+  m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  m_count.fetch_add(1, std::memory_order_relaxed);
+  m_sum.fetch_add(value, std::memory_order_relaxed);
+
+  uint64_t max = m_max.load(std::memory_order_relaxed);
+  while (value > max && !m_max.compare_exchange_weak(
+                            max, value, std::memory_order_relaxed)) {
+  }
+}
+
+void boilerplate::Histogram::reset() {
+  for (std::atomic<uint64_t>& bucket : m_buckets) bucket = 0;
+  m_count = 0;
+  m_sum = 0;
+  m_max = 0;
+}
+
+// Approximate: returns the upper bound of the bucket containing the p-th
+// percentile (0 <= p <= 1), but never more than the maximum recorded value.
+uint64_t boilerplate::Histogram::percentile(double p) const {
+  uint64_t total = count();
+  if (total == 0) return 0;
+
+  uint64_t target = uint64_t(p * double(total));
+  if (target == 0) target = 1;
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < BucketCount; i++) {
+    seen += m_buckets[i].load(std::memory_order_relaxed);
+    if (seen >= target) {
+      uint64_t upperBound = i == 0 ? 0 : (uint64_t(1) << i) - 1;
+      return std::min(upperBound, max());
+    }
+  }
+  return max();
+}
+
+void boilerplate::GCStats::reset() {
+  sliceMicros.reset();
+  cycleMicros.reset();
+  heapBytesBefore.reset();
+  heapBytesAfter.reset();
+  majorGCs = 0;
+  zonalGCs = 0;
+  slices = 0;
+  for (std::atomic<uint64_t>& count : reasons) count = 0;
+}
+
+static void PrintHistogram(FILE* out, const char* name,
+                           const boilerplate::Histogram& h) {
+  fprintf(out,
+          "  %s: count %" PRIu64 ", p50 %" PRIu64 ", p90 %" PRIu64
+          ", p99 %" PRIu64 ", max %" PRIu64 "\n",
+          name, h.count(), h.percentile(0.5), h.percentile(0.9),
+          h.percentile(0.99), h.max());
+}
+
+void boilerplate::GCStats::print(FILE* out) const {
+  fprintf(out, "GC: %" PRIu64 " major GCs (%" PRIu64 " zonal), %" PRIu64
+               " slices\n",
+          majorGCs.load(), zonalGCs.load(), slices.load());
+  PrintHistogram(out, "slice time (us)", sliceMicros);
+  PrintHistogram(out, "cycle time (us)", cycleMicros);
+  PrintHistogram(out, "heap bytes before", heapBytesBefore);
+  PrintHistogram(out, "heap bytes after", heapBytesAfter);
+
+  for (size_t i = 0; i < ReasonCount; i++) {
+    if (uint64_t count = reasons[i].load()) {
+      fprintf(out, "  reason %s: %" PRIu64 "\n",
+              JS::ExplainGCReason(JS::GCReason(i)), count);
+    }
+  }
+}
+
+namespace {
+struct GCStatsState {
+  JSContext* cx;
+  boilerplate::GCStats stats;
+  Clock::time_point cycleStart;
+  Clock::time_point sliceStart;
+  JS::GCSliceCallback previousSliceCallback;
+};
+}  // namespace
+
+// The slice callback doesn't get a data pointer, but there is only one context
+// per thread.
+static thread_local GCStatsState* gcStatsState = nullptr;
+
+static uint64_t MicrosecondsSince(Clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                               start)
+      .count();
+}
+
+static void OnGC(JSContext* cx, JSGCStatus status, JS::GCReason reason,
+                 void* data) {
+  auto* state = static_cast<GCStatsState*>(data);
+  uint64_t heapBytes = JS_GetGCParameter(cx, JSGC_BYTES);
+
+  if (status == JSGC_BEGIN) {
+    state->stats.heapBytesBefore.record(heapBytes);
+  } else if (status == JSGC_END) {
+    state->stats.heapBytesAfter.record(heapBytes);
+  }
+}
+
+static void OnGCSlice(JSContext* cx, JS::GCProgress progress,
+                      const JS::GCDescription& desc) {
+  GCStatsState* state = gcStatsState;
+  if (state && state->cx == cx) {
+    boilerplate::GCStats& stats = state->stats;
+
+    switch (progress) {
+      case JS::GCProgress::GC_CYCLE_BEGIN:
+        state->cycleStart = Clock::now();
+        stats.majorGCs.fetch_add(1, std::memory_order_relaxed);
+        if (desc.isZone_) {
+          stats.zonalGCs.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (size_t(desc.reason_) < stats.ReasonCount) {
+          stats.reasons[size_t(desc.reason_)].fetch_add(
+              1, std::memory_order_relaxed);
+        }
+        break;
+      case JS::GCProgress::GC_SLICE_BEGIN:
+        state->sliceStart = Clock::now();
+        break;
+      case JS::GCProgress::GC_SLICE_END:
+        stats.slices.fetch_add(1, std::memory_order_relaxed);
+        stats.sliceMicros.record(MicrosecondsSince(state->sliceStart));
+        break;
+      case JS::GCProgress::GC_CYCLE_END:
+        stats.cycleMicros.record(MicrosecondsSince(state->cycleStart));
+        break;
+    }
+  }
+
+  if (state && state->previousSliceCallback) {
+    state->previousSliceCallback(cx, progress, desc);
+  }
+}
+
+// Start collecting GC statistics for this context. Must be called on the
+// context's thread.
+bool boilerplate::EnableGCStats(JSContext* cx) {
+  if (gcStatsState) return gcStatsState->cx == cx;
+
+  auto state = std::make_unique<GCStatsState>();
+  state->cx = cx;
+  state->previousSliceCallback = JS::SetGCSliceCallback(cx, OnGCSlice);
+  JS_SetGCCallback(cx, OnGC, state.get());
+
+  gcStatsState = state.release();
+  return true;
+}
+
+// Stop collecting GC statistics, and discard them. This must be called before
+// the context is destroyed.
+void boilerplate::DisableGCStats(JSContext* cx) {
+  GCStatsState* state = gcStatsState;
+  if (!state || state->cx != cx) return;
+
+  JS_SetGCCallback(cx, nullptr, nullptr);
+  JS::SetGCSliceCallback(cx, state->previousSliceCallback);
+
+  gcStatsState = nullptr;
+  delete state;
+}
+
+// Returns null if statistics are not enabled for this context.
+boilerplate::GCStats* boilerplate::GetGCStats(JSContext* cx) {
+  GCStatsState* state = gcStatsState;
+  if (!state || state->cx != cx) return nullptr;
+  return &state->stats;
+}
+
+static bool DefineNumber(JSContext* cx, JS::HandleObject obj, const char* name,
+                         uint64_t value) {
+  return JS_DefineProperty(cx, obj, name, double(value), JSPROP_ENUMERATE);
+}
+
+static JSObject* HistogramToObject(JSContext* cx,
+                                   const boilerplate::Histogram& h) {
+  JS::RootedObject obj(cx, JS_NewPlainObject(cx));
+  if (!obj || !DefineNumber(cx, obj, "count", h.count()) ||
+      !DefineNumber(cx, obj, "sum", h.sum()) ||
+      !DefineNumber(cx, obj, "p50", h.percentile(0.5)) ||
+      !DefineNumber(cx, obj, "p90", h.percentile(0.9)) ||
+      !DefineNumber(cx, obj, "p99", h.percentile(0.99)) ||
+      !DefineNumber(cx, obj, "max", h.max())) {
+    return nullptr;
+  }
+  return obj;
+}
+
+// gcStats() returns a snapshot of the statistics as a plain object:
+//
+//   {majorGCs, zonalGCs, slices, heapBytes,
+//    sliceMicros: {count, sum, p50, p90, p99, max}, cycleMicros: {...},
+//    heapBytesBefore: {...}, heapBytesAfter: {...},
+//    reasons: {"API": 3, ...}}
+static bool GCStatsNative(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+
+  const boilerplate::GCStats* stats = boilerplate::GetGCStats(cx);
+  if (!stats) {
+    JS_ReportErrorASCII(cx, "GC statistics are not enabled");
+    return false;
+  }
+
+  JS::RootedObject result(cx, JS_NewPlainObject(cx));
+  if (!result) return false;
+
+  if (!DefineNumber(cx, result, "majorGCs", stats->majorGCs) ||
+      !DefineNumber(cx, result, "zonalGCs", stats->zonalGCs) ||
+      !DefineNumber(cx, result, "slices", stats->slices) ||
+      !DefineNumber(cx, result, "heapBytes",
+                    JS_GetGCParameter(cx, JSGC_BYTES))) {
+    return false;
+  }
+
+  struct {
+    const char* name;
+    const boilerplate::Histogram& histogram;
+  } histograms[] = {
+      {"sliceMicros", stats->sliceMicros},
+      {"cycleMicros", stats->cycleMicros},
+      {"heapBytesBefore", stats->heapBytesBefore},
+      {"heapBytesAfter", stats->heapBytesAfter},
+  };
+  JS::RootedObject obj(cx);
+  for (const auto& entry : histograms) {
+    obj = HistogramToObject(cx, entry.histogram);
+    if (!obj ||
+        !JS_DefineProperty(cx, result, entry.name, obj, JSPROP_ENUMERATE)) {
+      return false;
+    }
+  }
+
+  obj = JS_NewPlainObject(cx);
+  if (!obj ||
+      !JS_DefineProperty(cx, result, "reasons", obj, JSPROP_ENUMERATE)) {
+    return false;
+  }
+  for (size_t i = 0; i < stats->ReasonCount; i++) {
+    uint64_t count = stats->reasons[i];
+    if (count > 0 &&
+        !DefineNumber(cx, obj, JS::ExplainGCReason(JS::GCReason(i)), count)) {
+      return false;
+    }
+  }
+
+  args.rval().setObject(*result);
+  return true;
+}
+
+bool boilerplate::DefineGCStatsFunction(JSContext* cx,
+                                        JS::HandleObject global) {
+  return JS_DefineFunction(cx, global, "gcStats", &GCStatsNative, 0, 0);
+}
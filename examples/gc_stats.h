@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include <jsapi.h>
+#include <js/GCAPI.h>
+
+// See 'gc_stats.cpp' for documentation.
+
+namespace boilerplate {
+
+class Histogram {
+ public:
+  // Bucket i counts values v with 2^(i-1) <= v < 2^i (bucket 0 counts zeros.)
+  static constexpr size_t BucketCount = 48;
+
+  Histogram();
+
+  void record(uint64_t value);
+  void reset();
+
+  uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+  uint64_t sum() const { return m_sum.load(std::memory_order_relaxed); }
+  uint64_t max() const { return m_max.load(std::memory_order_relaxed); }
+  uint64_t percentile(double p) const;
+
+ private:
+  std::array<std::atomic<uint64_t>, BucketCount> m_buckets;
+  std::atomic<uint64_t> m_count;
+  std::atomic<uint64_t> m_sum;
+  std::atomic<uint64_t> m_max;
+};
+
+struct GCStats {
+  static constexpr size_t ReasonCount = size_t(JS::GCReason::NUM_REASONS);
+
+  // Durations in microseconds.
+  Histogram sliceMicros;
+  Histogram cycleMicros;
+  // GC heap size, at the start and at the end of each major GC.
+  Histogram heapBytesBefore;
+  Histogram heapBytesAfter;
+
+  std::atomic<uint64_t> majorGCs{0};
+  std::atomic<uint64_t> zonalGCs{0};
+  std::atomic<uint64_t> slices{0};
+  std::array<std::atomic<uint64_t>, ReasonCount> reasons{};
+
+  void reset();
+  void print(FILE* out) const;
+};
+
+bool EnableGCStats(JSContext* cx);
+void DisableGCStats(JSContext* cx);
+GCStats* GetGCStats(JSContext* cx);
+
+bool DefineGCStatsFunction(JSContext* cx, JS::HandleObject global);
+
+}  // namespace boilerplate
@@ -5,6 +5,7 @@
 #include <js/SourceText.h>
 
 #include "boilerplate.h"
+#include "script_cache.h"
 
 // This example illustrates the bare minimum you need to do to execute a
 // JavaScript program using embedded SpiderMonkey. It does no error handling and
@@ -26,8 +27,11 @@ static bool ExecuteCodePrintResult(JSContext* cx, const char* code) {
     return false;
   }
 
+  // This works like JS::Evaluate(), but can keep the compiled code in a cache
+  // on disk so that later runs don't need to parse the source again. See
+  // 'script_cache.cpp'.
   JS::RootedValue rval(cx);
-  if (!JS::Evaluate(cx, options, source, &rval)) return false;
+  if (!boilerplate::EvaluateCached(cx, options, source, &rval)) return false;
 
   // There are many ways to display an arbitrary value as a result. In this
   // case, we know that the value is an ASCII string because of the expression
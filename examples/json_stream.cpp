@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <jsapi.h>
+#include <js/CharacterEncoding.h>
+#include <js/JSON.h>
+#include <js/String.h>
+#include <mozilla/Span.h>
+
+#include "json_stream.h"
+#include "mapped_file.h"
+
+// Converting large JSON documents between C++ and JS values without making
+// full-size copies along the way.
+//
+// The usual way to get JSON out of the engine is to call JSON.stringify(),
+// which creates a JS string of the whole document, and then to convert that to
+// UTF-8 with JS_EncodeStringToUTF8(), another full-size copy. StringifyJSON()
+// uses JS_Stringify() instead, which hands its UTF-16 output to a callback
+// instead of creating a string, and converts it to UTF-8 a small buffer at a
+// time, passing each piece to a JSONSink: a function, a ChunkedBuffer, or a
+// file descriptor. Note that SpiderMonkey still builds the UTF-16 text in its
+// own buffer and currently passes it to the callback in one piece, so the peak
+// memory use is that buffer plus one of our small ones, instead of that buffer
+// plus a JS string plus a UTF-8 copy.
+//
+// In the other direction, ParseJSON() parses UTF-8 text from memory the
+// embedding owns, for example a file mapped with ParseJSONFile(). JSON is most
+// often ASCII, and ASCII is also valid Latin-1, which JS_ParseJSON() can parse
+// directly, with no copy at all. Otherwise, the text is first converted to a JS
+// string, which the engine stores as Latin-1 if it can, and that is parsed.
+//
+// Errors, including JSON syntax errors and failures to write to a file, are
+// reported on the context as exceptions.
+
+///// ChunkedBuffer ////////////////////////////////////////////////////////////
+
+boilerplate::ChunkedBuffer::ChunkedBuffer(size_t chunkSize)
+    : m_chunkSize(chunkSize) {}
+
+void boilerplate::ChunkedBuffer::append(std::string_view data) {
+  while (!data.empty()) {
+    size_t index = m_size / m_chunkSize;
+    size_t offset = m_size % m_chunkSize;
+    if (index == m_chunks.size()) {
+      m_chunks.push_back(std::make_unique<char[]>(m_chunkSize));
+    }
+
+    size_t n = std::min(data.size(), m_chunkSize - offset);
+    memcpy(m_chunks[index].get() + offset, data.data(), n);
+    m_size += n;
+    data.remove_prefix(n);
+  }
+}
+
+size_t boilerplate::ChunkedBuffer::chunkCount() const {
+  return (m_size + m_chunkSize - 1) / m_chunkSize;
+}
+
+std::string_view boilerplate::ChunkedBuffer::chunk(size_t index) const {
+  size_t length = std::min(m_chunkSize, m_size - index * m_chunkSize);
+  return {m_chunks[index].get(), length};
+}
+
+static bool WriteAll(int fd, std::string_view data) {
+  while (!data.empty()) {
+    ssize_t n = write(fd, data.data(), data.size());
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data.remove_prefix(size_t(n));
+  }
+  return true;
+}
+
+// Returns false with errno set if writing failed.
+bool boilerplate::ChunkedBuffer::writeTo(int fd) const {
+  for (size_t i = 0; i < chunkCount(); i++) {
+    if (!WriteAll(fd, chunk(i))) return false;
+  }
+  return true;
+}
+
+std::string boilerplate::ChunkedBuffer::toString() const {
+  std::string result;
+  result.reserve(m_size);
+  for (size_t i = 0; i < chunkCount(); i++) result.append(chunk(i));
+  return result;
+}
+
+///// Stringifying /////////////////////////////////////////////////////////////
+
+namespace {
+// Converts UTF-16 to UTF-8 through a fixed-size buffer. A surrogate pair may
+// be split between two calls to write(); unpaired surrogates, which
+// JSON.stringify() escapes anyway, become U+FFFD.
+class UTF8Encoder {
+  static constexpr size_t BufferSize = 32 * 1024;
+
+  const boilerplate::JSONSink& m_sink;
+  size_t m_used = 0;
+  char16_t m_highSurrogate = 0;
+  char m_buffer[BufferSize];
+
+  static bool IsLead(char32_t c) { return c >= 0xD800 && c <= 0xDBFF; }
+  static bool IsTrail(char32_t c) { return c >= 0xDC00 && c <= 0xDFFF; }
+  static char32_t Combine(char32_t lead, char32_t trail) {
+    return 0x10000 + ((lead - 0xD800) << 10) + (trail - 0xDC00);
+  }
+
+  // Make room for one code point.
+  bool reserve() { return BufferSize - m_used >= 4 || flush(); }
+
+  void put(char32_t c) {
+    auto* out = reinterpret_cast<unsigned char*>(m_buffer + m_used);
+    if (c < 0x80) {
+      out[0] = c;
+      m_used += 1;
+    } else if (c < 0x800) {
+      out[0] = 0xC0 | (c >> 6);
+      out[1] = 0x80 | (c & 0x3F);
+      m_used += 2;
+    } else if (c < 0x10000) {
+      out[0] = 0xE0 | (c >> 12);
+      out[1] = 0x80 | ((c >> 6) & 0x3F);
+      out[2] = 0x80 | (c & 0x3F);
+      m_used += 3;
+    } else {
+      out[0] = 0xF0 | (c >> 18);
+      out[1] = 0x80 | ((c >> 12) & 0x3F);
+      out[2] = 0x80 | ((c >> 6) & 0x3F);
+      out[3] = 0x80 | (c & 0x3F);
+      m_used += 4;
+    }
+  }
+
+ public:
+  explicit UTF8Encoder(const boilerplate::JSONSink& sink) : m_sink(sink) {}
+
+  bool write(const char16_t* chars, size_t length) {
+    const char16_t* end = chars + length;
+
+    if (m_highSurrogate && chars < end) {
+      char32_t c = 0xFFFD;
+      if (IsTrail(*chars)) c = Combine(m_highSurrogate, *chars++);
+      m_highSurrogate = 0;
+      if (!reserve()) return false;
+      put(c);
+    }
+
+    while (chars < end) {
+      if (!reserve()) return false;
+
+      // Copy a run of ASCII, which is most of a typical document.
+      size_t room = std::min(size_t(end - chars), BufferSize - m_used);
+      char* out = m_buffer + m_used;
+      size_t n = 0;
+      while (n < room && chars[n] < 0x80) {
+        out[n] = char(chars[n]);
+        n++;
+      }
+      m_used += n;
+      chars += n;
+      if (n == room) continue;
+      if (!reserve()) return false;
+
+      char32_t c = *chars++;
+      if (IsLead(c)) {
+        if (chars == end) {
+          m_highSurrogate = c;
+          return true;
+        }
+        c = IsTrail(*chars) ? Combine(c, *chars++) : 0xFFFD;
+      } else if (IsTrail(c)) {
+        c = 0xFFFD;
+      }
+      put(c);
+    }
+    return true;
+  }
+
+  bool finish() {
+    if (m_highSurrogate) {
+      m_highSurrogate = 0;
+      if (!reserve()) return false;
+      put(0xFFFD);
+    }
+    return m_used == 0 || flush();
+  }
+
+  bool flush() {
+    bool ok = m_sink(std::string_view(m_buffer, m_used));
+    m_used = 0;
+    return ok;
+  }
+};
+}  // namespace
+
+static bool WriteJSON(const char16_t* chars, uint32_t length, void* data) {
+  return static_cast<UTF8Encoder*>(data)->write(chars, length);
+}
+
+// Write the JSON text of 'value' to 'sink' as UTF-8. Like JSON.stringify(),
+// 'space' is the indentation: a number of spaces or a string.
+bool boilerplate::StringifyJSON(JSContext* cx, JS::HandleValue value,
+                                const JSONSink& sink, JS::HandleValue space) {
+  // Keep the encoder's buffer off the stack.
+  auto encoder = std::make_unique<UTF8Encoder>(sink);
+
+  JS::RootedValue v(cx, value);
+  if (!JS_Stringify(cx, &v, nullptr, space, WriteJSON, encoder.get())) {
+    return false;
+  }
+  return encoder->finish();
+}
+
+// The same, appending to a buffer.
+bool boilerplate::StringifyJSON(JSContext* cx, JS::HandleValue value,
+                                ChunkedBuffer* out, JS::HandleValue space) {
+  return StringifyJSON(
+      cx, value,
+      [out](std::string_view data) {
+        out->append(data);
+        return true;
+      },
+      space);
+}
+
+// The same, writing to a file descriptor.
+bool boilerplate::StringifyJSONToFile(JSContext* cx, JS::HandleValue value,
+                                      int fd, JS::HandleValue space) {
+  return StringifyJSON(
+      cx, value,
+      [cx, fd](std::string_view data) {
+        if (WriteAll(fd, data)) return true;
+        JS_ReportErrorUTF8(cx, "can't write JSON: %s", strerror(errno));
+        return false;
+      },
+      space);
+}
+
+///// Parsing //////////////////////////////////////////////////////////////////
+
+// Parse JSON text in UTF-8, without copying it if it is ASCII.
+bool boilerplate::ParseJSON(JSContext* cx, const uint8_t* utf8, size_t length,
+                            JS::MutableHandleValue vp) {
+  if (length > JS::MaxStringLength) {
+    JS_ReportErrorASCII(cx, "JSON text is too long");
+    return false;
+  }
+
+  auto chars = reinterpret_cast<const char*>(utf8);
+  if (JS::StringIsASCII(mozilla::Span<const char>(chars, length))) {
+    return JS_ParseJSON(cx, utf8, uint32_t(length), vp);
+  }
+
+  JS::RootedString str(
+      cx, JS_NewStringCopyUTF8N(cx, JS::UTF8Chars(chars, length)));
+  if (!str) return false;
+  return JS_ParseJSON(cx, str, vp);
+}
+
+// Parse a JSON file in UTF-8, mapping it into memory instead of reading it.
+bool boilerplate::ParseJSONFile(JSContext* cx, const char* path,
+                                JS::MutableHandleValue vp) {
+  // Empty files can't be mapped; let the parser report the syntax error.
+  struct stat info;
+  if (stat(path, &info) == 0 && info.st_size == 0) {
+    return ParseJSON(cx, reinterpret_cast<const uint8_t*>(""), 0, vp);
+  }
+
+  MappedFile file;
+  if (!file.map(path)) {
+    JS_ReportErrorUTF8(cx, "can't open %s: %s", path, strerror(file.error()));
+    return false;
+  }
+  return ParseJSON(cx, file.data(), file.size(), vp);
+}
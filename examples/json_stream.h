@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <jsapi.h>
+
+// See 'json_stream.cpp' for documentation.
+
+namespace boilerplate {
+
+// A byte buffer made of fixed-size chunks, so that it never has to be copied
+// to grow. clear() keeps the chunks for the next use.
+class ChunkedBuffer {
+ public:
+  explicit ChunkedBuffer(size_t chunkSize = 64 * 1024);
+
+  ChunkedBuffer(const ChunkedBuffer&) = delete;
+  ChunkedBuffer& operator=(const ChunkedBuffer&) = delete;
+
+  void append(std::string_view data);
+  void clear() { m_size = 0; }
+
+  size_t size() const { return m_size; }
+  size_t chunkCount() const;
+  std::string_view chunk(size_t index) const;
+
+  bool writeTo(int fd) const;
+  std::string toString() const;
+
+ private:
+  size_t m_chunkSize;
+  size_t m_size = 0;
+  std::vector<std::unique_ptr<char[]>> m_chunks;
+};
+
+// Receives the UTF-8 output of StringifyJSON() a piece at a time. Returning
+// false stops the stringification; report an error on the context first.
+using JSONSink = std::function<bool(std::string_view data)>;
+
+bool StringifyJSON(JSContext* cx, JS::HandleValue value, const JSONSink& sink,
+                   JS::HandleValue space = JS::UndefinedHandleValue);
+bool StringifyJSON(JSContext* cx, JS::HandleValue value, ChunkedBuffer* out,
+                   JS::HandleValue space = JS::UndefinedHandleValue);
+bool StringifyJSONToFile(JSContext* cx, JS::HandleValue value, int fd,
+                         JS::HandleValue space = JS::UndefinedHandleValue);
+
+bool ParseJSON(JSContext* cx, const uint8_t* utf8, size_t length,
+               JS::MutableHandleValue vp);
+bool ParseJSONFile(JSContext* cx, const char* path, JS::MutableHandleValue vp);
+
+}  // namespace boilerplate
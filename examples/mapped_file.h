@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace boilerplate {
+
+// A read-only memory mapping of a whole file, unmapped when it goes out of
+// scope. Pages are only read from disk as they are touched, and since they are
+// backed by the file, the kernel can drop them again under memory pressure.
+class MappedFile {
+  void* m_base;
+  size_t m_size;
+  int m_error;
+
+ public:
+  MappedFile() : m_base(nullptr), m_size(0), m_error(0) {}
+  ~MappedFile() {
+    if (m_base) munmap(m_base, m_size);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Returns false if the file could not be opened or mapped, with the reason
+  // in error(). Empty files can't be mapped, and are also reported as failure.
+  bool map(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+      m_error = errno;
+      return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+      m_error = errno;
+    } else if (info.st_size == 0) {
+      m_error = EINVAL;
+    } else {
+      void* base = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE,
+                        fd, 0);
+      if (base != MAP_FAILED) {
+        m_base = base;
+        m_size = size_t(info.st_size);
+      } else {
+        m_error = errno;
+      }
+    }
+
+    // Saved above, since close() may change errno.
+    close(fd);
+    return m_base;
+  }
+
+  const uint8_t* data() const { return static_cast<const uint8_t*>(m_base); }
+  size_t size() const { return m_size; }
+  // The errno value of the last failed map().
+  int error() const { return m_error; }
+};
+
+}  // namespace boilerplate
@@ -0,0 +1,184 @@
+#include <cstdio>
+#include <utility>
+
+#ifdef __APPLE__
+#  include <malloc/malloc.h>
+#else
+#  include <malloc.h>
+#endif
+
+#include <jsapi.h>
+#include <js/GCAPI.h>
+#include <js/MemoryMetrics.h>
+#include <js/Object.h>
+#include <js/Realm.h>
+
+#include "memory_report.h"
+
+// A breakdown of where a runtime's memory goes, per realm and per zone, for
+// embeddings that create many globals and need to know which ones are
+// expensive.
+//
+// MemoryReport::collect() uses JS::CollectRuntimeStats(), which walks the whole
+// GC heap and measures every GC thing and the malloc'd memory hanging off it.
+// That takes time proportional to the size of the heap, so it is meant for
+// diagnostics and periodic sampling, not for every request. From the detailed
+// numbers, we keep the ones that usually matter:
+//
+// - per realm: GC heap used by objects, malloc'd object slots and elements,
+//   scripts and their data, JIT data, and memory that the embedding attributes
+//   to the realm (through the 'embedderSize' hook);
+// - per zone: strings, JIT code, and all live GC things;
+// - for the runtime: the GC heap's chunks, and how much of them is unused.
+//
+// Realms are named with the 'nameRealm' hook if given, or else by the class
+// name of their global object. toJSON() serializes the report.
+
+// Measure the size of a heap block, as SpiderMonkey needs it to measure its
+// malloc'd memory. This assumes SpiderMonkey was built without jemalloc (as
+// recommended in "Building SpiderMonkey.md") so it uses the system allocator.
+static size_t MallocSizeOf(const void* ptr) {
+  if (!ptr) return 0;
+#ifdef __APPLE__
+  return malloc_size(ptr);
+#else
+  return malloc_usable_size(const_cast<void*>(ptr));
+#endif
+}
+
+namespace {
+class ReportRuntimeStats : public JS::RuntimeStats {
+  boilerplate::MemoryReport* m_report;
+
+ public:
+  explicit ReportRuntimeStats(boilerplate::MemoryReport* report)
+      : JS::RuntimeStats(MallocSizeOf), m_report(report) {}
+
+  // JS::RuntimeStats override
+  void initExtraZoneStats(JS::Zone* zone, JS::ZoneStats* zStats,
+                          const JS::AutoRequireNoGC& nogc) override {}
+
+  // JS::RuntimeStats override
+  void initExtraRealmStats(JS::Realm* realm, JS::RealmStats* rStats,
+                           const JS::AutoRequireNoGC& nogc) override {
+    // The realm stats are filled in after this is called, in the same order as
+    // realmStatsVector, so record the extra information in that order too.
+    boilerplate::MemoryReport::Realm entry;
+    if (m_report->nameRealm) {
+      entry.name = m_report->nameRealm(realm);
+    } else if (JSObject* global = JS::GetRealmGlobalOrNull(realm)) {
+      entry.name = JS::GetClass(global)->name;
+    } else {
+      entry.name = "(no global)";
+    }
+    if (m_report->embedderSize) entry.embedder = m_report->embedderSize(realm);
+
+    m_report->realms.push_back(std::move(entry));
+  }
+};
+}  // namespace
+
+// Walk the heap and fill in the report. Returns false on out of memory.
+bool boilerplate::MemoryReport::collect(JSContext* cx) {
+  realms.clear();
+  zones.clear();
+
+  ReportRuntimeStats stats(this);
+  if (!JS::CollectRuntimeStats(cx, &stats, nullptr, /* anonymize = */ false)) {
+    return false;
+  }
+
+  gcHeapChunkTotal = stats.gcHeapChunkTotal;
+  gcHeapUnusedChunks = stats.gcHeapUnusedChunks;
+  gcHeapUnusedArenas = stats.gcHeapUnusedArenas;
+  gcHeapBytes = JS_GetGCParameter(cx, JSGC_BYTES);
+
+  size_t i = 0;
+  for (const JS::RealmStats& rStats : stats.realmStatsVector) {
+    if (i >= realms.size()) break;
+    Realm& realm = realms[i++];
+
+    realm.gcHeapObjects = rStats.classInfo.objectsGCHeap;
+    realm.mallocSlots = rStats.classInfo.objectsMallocHeapSlots;
+    realm.mallocElements = rStats.classInfo.objectsMallocHeapElementsNormal;
+    realm.gcHeapScripts = rStats.scriptsGCHeap;
+    realm.mallocScriptData = rStats.scriptsMallocHeapData;
+    realm.jitData = rStats.baselineData + rStats.ionData + rStats.jitScripts;
+  }
+
+  for (const JS::ZoneStats& zStats : stats.zoneStatsVector) {
+    Zone zone;
+    zone.gcHeapStrings =
+        zStats.stringInfo.gcHeapLatin1 + zStats.stringInfo.gcHeapTwoByte;
+    zone.mallocStrings = zStats.stringInfo.mallocHeapLatin1 +
+                         zStats.stringInfo.mallocHeapTwoByte;
+    zone.gcHeapJitCode = zStats.jitCodesGCHeap;
+    zone.gcHeapLiveThings = zStats.sizeOfLiveGCThings();
+    zones.push_back(zone);
+  }
+
+  return true;
+}
+
+static void AppendField(std::string* out, const char* name, size_t value,
+                        bool last = false) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "\"%s\": %zu%s", name, value, last ? "" : ", ");
+  *out += buf;
+}
+
+static void AppendJSONString(std::string* out, const std::string& str) {
+  *out += '"';
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      *out += '\\';
+      *out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      *out += buf;
+    } else {
+      *out += c;
+    }
+  }
+  *out += '"';
+}
+
+std::string boilerplate::MemoryReport::toJSON() const {
+  std::string out = "{";
+  AppendField(&out, "gcHeapChunkTotal", gcHeapChunkTotal);
+  AppendField(&out, "gcHeapUnusedChunks", gcHeapUnusedChunks);
+  AppendField(&out, "gcHeapUnusedArenas", gcHeapUnusedArenas);
+  AppendField(&out, "gcHeapBytes", gcHeapBytes);
+
+  out += "\"realms\": [";
+  for (size_t i = 0; i < realms.size(); i++) {
+    const Realm& realm = realms[i];
+    out += "{\"name\": ";
+    AppendJSONString(&out, realm.name);
+    out += ", ";
+    AppendField(&out, "gcHeapObjects", realm.gcHeapObjects);
+    AppendField(&out, "mallocSlots", realm.mallocSlots);
+    AppendField(&out, "mallocElements", realm.mallocElements);
+    AppendField(&out, "gcHeapScripts", realm.gcHeapScripts);
+    AppendField(&out, "mallocScriptData", realm.mallocScriptData);
+    AppendField(&out, "jitData", realm.jitData);
+    AppendField(&out, "embedder", realm.embedder, /* last = */ true);
+    out += i + 1 < realms.size() ? "}, " : "}";
+  }
+
+  out += "], \"zones\": [";
+  for (size_t i = 0; i < zones.size(); i++) {
+    const Zone& zone = zones[i];
+    out += "{";
+    AppendField(&out, "gcHeapStrings", zone.gcHeapStrings);
+    AppendField(&out, "mallocStrings", zone.mallocStrings);
+    AppendField(&out, "gcHeapJitCode", zone.gcHeapJitCode);
+    AppendField(&out, "gcHeapLiveThings", zone.gcHeapLiveThings,
+                /* last = */ true);
+    out += i + 1 < zones.size() ? "}, " : "}";
+  }
+  out += "]}";
+
+  return out;
+}
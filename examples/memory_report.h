@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <jsapi.h>
+
+// See 'memory_report.cpp' for documentation.
+
+namespace boilerplate {
+
+struct MemoryReport {
+  struct Realm {
+    std::string name;
+    size_t gcHeapObjects = 0;
+    size_t mallocSlots = 0;
+    size_t mallocElements = 0;
+    size_t gcHeapScripts = 0;
+    size_t mallocScriptData = 0;
+    size_t jitData = 0;
+    size_t embedder = 0;
+  };
+
+  struct Zone {
+    size_t gcHeapStrings = 0;
+    size_t mallocStrings = 0;
+    size_t gcHeapJitCode = 0;
+    size_t gcHeapLiveThings = 0;
+  };
+
+  size_t gcHeapChunkTotal = 0;
+  size_t gcHeapUnusedChunks = 0;
+  size_t gcHeapUnusedArenas = 0;
+  size_t gcHeapBytes = 0;
+  std::vector<Realm> realms;
+  std::vector<Zone> zones;
+
+  // Optional hooks, called for each realm while collecting. They must not
+  // call into the JSAPI, since the GC is not allowed to run at that point.
+  std::function<std::string(JS::Realm*)> nameRealm;
+  std::function<size_t(JS::Realm*)> embedderSize;
+
+  bool collect(JSContext* cx);
+  std::string toJSON() const;
+};
+
+}  // namespace boilerplate
@@ -130,7 +130,7 @@ static bool ModuleExample(JSContext* cx) {
   if (!js::UseInternalJobQueues(cx)) return false;
 
   // We must instantiate self-hosting *after* setting up job queue.
-  if (!JS::InitSelfHostedCode(cx)) return false;
+  if (!boilerplate::InitSelfHostedCode(cx)) return false;
 
   JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
   if (!global) {
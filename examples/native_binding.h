@@ -0,0 +1,268 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <jsapi.h>
+#include <js/CallArgs.h>
+#include <js/CharacterEncoding.h>
+#include <js/Conversions.h>
+#include <js/PropertySpec.h>
+#include <js/String.h>
+#include <js/Value.h>
+#include <mozilla/Maybe.h>
+#include <mozilla/Span.h>
+
+// Generate JSNatives from plain C++ functions, instead of unpacking
+// JS::CallArgs by hand in every native. For example:
+//
+//   static int32_t Add(int32_t a, int32_t b) { return a + b; }
+//   static void Log(std::string_view message) { ... }
+//
+//   static JSFunctionSpec functions[] = {
+//       boilerplate::FunctionSpec<Add>("add"),
+//       boilerplate::FunctionSpec<Log>("log"),
+//       JS_FS_END};
+//
+// or, for a single function,
+//
+//   JS_DefineFunction(cx, global, "add", boilerplate::NativeFunction<Add>,
+//                     boilerplate::NativeArity<Add>, 0);
+//
+// Arguments are converted like the corresponding JS::To*() function would,
+// with missing arguments treated as undefined. Values that already have the
+// wanted type skip the conversion, so that int32_t, double and bool arguments
+// cost no more than a type check. The arguments are rooted by the caller
+// already, so nothing is rooted except strings being converted.
+//
+// Supported argument types are int32_t, uint32_t, double, bool, std::string,
+// std::string_view (valid for the duration of the call) and JS::HandleValue.
+// Supported return types are void, the same numeric and boolean types,
+// std::string and const char*. Strings are UTF-8.
+//
+// The generated native fails only if an argument conversion throws (for
+// example when valueOf() throws) or on out of memory. Functions that need to
+// report their own errors should be written as ordinary JSNatives.
+
+namespace boilerplate {
+
+namespace detail {
+
+template <typename T>
+struct ArgConverter;
+
+template <>
+struct ArgConverter<int32_t> {
+  using Storage = int32_t;
+  static bool convert(JSContext* cx, JS::HandleValue v, Storage* out) {
+    if (v.isInt32()) {
+      *out = v.toInt32();
+      return true;
+    }
+    return JS::ToInt32(cx, v, out);
+  }
+  static int32_t unwrap(Storage& s) { return s; }
+};
+
+template <>
+struct ArgConverter<uint32_t> {
+  using Storage = uint32_t;
+  static bool convert(JSContext* cx, JS::HandleValue v, Storage* out) {
+    if (v.isInt32() && v.toInt32() >= 0) {
+      *out = uint32_t(v.toInt32());
+      return true;
+    }
+    return JS::ToUint32(cx, v, out);
+  }
+  static uint32_t unwrap(Storage& s) { return s; }
+};
+
+template <>
+struct ArgConverter<double> {
+  using Storage = double;
+  static bool convert(JSContext* cx, JS::HandleValue v, Storage* out) {
+    if (v.isNumber()) {
+      *out = v.toNumber();
+      return true;
+    }
+    return JS::ToNumber(cx, v, out);
+  }
+  static double unwrap(Storage& s) { return s; }
+};
+
+template <>
+struct ArgConverter<bool> {
+  using Storage = bool;
+  static bool convert(JSContext* cx, JS::HandleValue v, Storage* out) {
+    *out = v.isBoolean() ? v.toBoolean() : JS::ToBoolean(v);
+    return true;
+  }
+  static bool unwrap(Storage& s) { return s; }
+};
+
+template <>
+struct ArgConverter<std::string> {
+  using Storage = std::string;
+  static bool convert(JSContext* cx, JS::HandleValue v, Storage* out) {
+    JS::RootedString str(cx, v.isString() ? v.toString() : JS::ToString(cx, v));
+    if (!str) return false;
+
+    // Encode into the std::string directly, instead of through a C string,
+    // so that embedded NULs are kept. Each UTF-16 code unit becomes at most 3
+    // bytes of UTF-8.
+    out->resize(JS_GetStringLength(str) * 3);
+    mozilla::Maybe<std::tuple<size_t, size_t>> result =
+        JS_EncodeStringToUTF8BufferPartial(
+            cx, str, mozilla::Span<char>(out->data(), out->size()));
+    // This only fails if the string could not be flattened, which has
+    // reported the error already.
+    if (!result) return false;
+    out->resize(std::get<1>(*result));
+    return true;
+  }
+  static std::string unwrap(Storage& s) { return std::move(s); }
+};
+
+template <>
+struct ArgConverter<std::string_view> : ArgConverter<std::string> {
+  static std::string_view unwrap(Storage& s) { return s; }
+};
+
+template <>
+struct ArgConverter<JS::HandleValue> {
+  // Handles aren't default-constructible, so keep the address of the rooted
+  // argument instead.
+  using Storage = const JS::Value*;
+  static bool convert(JSContext* cx, JS::HandleValue v, Storage* out) {
+    *out = v.address();
+    return true;
+  }
+  static JS::HandleValue unwrap(Storage& s) {
+    return JS::HandleValue::fromMarkedLocation(s);
+  }
+};
+
+template <typename T>
+struct ReturnConverter;
+
+template <>
+struct ReturnConverter<int32_t> {
+  static bool set(JSContext* cx, int32_t v, JS::MutableHandleValue rval) {
+    rval.setInt32(v);
+    return true;
+  }
+};
+
+template <>
+struct ReturnConverter<uint32_t> {
+  static bool set(JSContext* cx, uint32_t v, JS::MutableHandleValue rval) {
+    rval.setNumber(v);
+    return true;
+  }
+};
+
+template <>
+struct ReturnConverter<double> {
+  static bool set(JSContext* cx, double v, JS::MutableHandleValue rval) {
+    rval.setNumber(v);
+    return true;
+  }
+};
+
+template <>
+struct ReturnConverter<bool> {
+  static bool set(JSContext* cx, bool v, JS::MutableHandleValue rval) {
+    rval.setBoolean(v);
+    return true;
+  }
+};
+
+template <>
+struct ReturnConverter<std::string> {
+  static bool set(JSContext* cx, const std::string& v,
+                  JS::MutableHandleValue rval) {
+    JSString* str =
+        JS_NewStringCopyUTF8N(cx, JS::UTF8Chars(v.data(), v.length()));
+    if (!str) return false;
+    rval.setString(str);
+    return true;
+  }
+};
+
+template <>
+struct ReturnConverter<const char*> {
+  static bool set(JSContext* cx, const char* v, JS::MutableHandleValue rval) {
+    JSString* str =
+        JS_NewStringCopyUTF8Z(cx, JS::ConstUTF8CharsZ(v, strlen(v)));
+    if (!str) return false;
+    rval.setString(str);
+    return true;
+  }
+};
+
+template <typename T>
+using ArgType = std::remove_cv_t<std::remove_reference_t<T>>;
+
+// Convert the call's arguments to Args... and pass them to fn, then convert
+// its return value. Shared with the methods generated by 'native_class.h'.
+template <typename R, typename... Args, typename F, size_t... I>
+bool InvokeWithArgsImpl(JSContext* cx, const JS::CallArgs& args, F&& fn,
+                        std::index_sequence<I...>) {
+  std::tuple<typename ArgConverter<ArgType<Args>>::Storage...> storage;
+  if (!(ArgConverter<ArgType<Args>>::convert(cx, args.get(I),
+                                             &std::get<I>(storage)) &&
+        ...)) {
+    return false;
+  }
+
+  if constexpr (std::is_void_v<R>) {
+    fn(ArgConverter<ArgType<Args>>::unwrap(std::get<I>(storage))...);
+    args.rval().setUndefined();
+    return true;
+  } else {
+    return ReturnConverter<ArgType<R>>::set(
+        cx, fn(ArgConverter<ArgType<Args>>::unwrap(std::get<I>(storage))...),
+        args.rval());
+  }
+}
+
+template <typename R, typename... Args, typename F>
+bool InvokeWithArgs(JSContext* cx, const JS::CallArgs& args, F&& fn) {
+  return InvokeWithArgsImpl<R, Args...>(cx, args, std::forward<F>(fn),
+                                        std::index_sequence_for<Args...>{});
+}
+
+template <auto Fn>
+struct NativeBinding;
+
+template <typename R, typename... Args, R (*Fn)(Args...)>
+struct NativeBinding<Fn> {
+  static constexpr unsigned Arity = sizeof...(Args);
+
+  static bool Call(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    return InvokeWithArgs<R, Args...>(cx, args, Fn);
+  }
+};
+
+}  // namespace detail
+
+template <auto Fn>
+constexpr JSNative NativeFunction = detail::NativeBinding<Fn>::Call;
+
+template <auto Fn>
+constexpr unsigned NativeArity = detail::NativeBinding<Fn>::Arity;
+
+template <auto Fn>
+constexpr JSFunctionSpec FunctionSpec(const char* name,
+                                      unsigned flags = JSPROP_ENUMERATE) {
+  return JS_FN(name, NativeFunction<Fn>, NativeArity<Fn>, flags);
+}
+
+}  // namespace boilerplate
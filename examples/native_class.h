@@ -0,0 +1,331 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <jsapi.h>
+#include <jsfriendapi.h>
+#include <js/CallArgs.h>
+#include <js/Class.h>
+#include <js/MemoryFunctions.h>
+#include <js/Object.h>
+#include <js/PropertySpec.h>
+#include <js/friend/ErrorMessages.h>
+
+#include "native_binding.h"
+
+// Expose a C++ struct to JS as a class, with the JSClass, constructor,
+// accessors, methods and finalizer generated from a list of fields and
+// methods. This is the pattern of MyClass in 'cookbook.cpp' and Crc in
+// 'resolve.cpp', without writing each JSNative by hand:
+//
+//   struct Point {
+//     double x;
+//     double y;
+//
+//     Point(double x_, double y_) : x(x_), y(y_) {}
+//     double length() const { return std::hypot(x, y); }
+//     void scale(double factor) { x *= factor; y *= factor; }
+//
+//     static constexpr const char* className = "Point";
+//     using ConstructorArgs = std::tuple<double, double>;
+//     static const JSPropertySpec properties[];
+//     static const JSFunctionSpec methods[];
+//   };
+//
+//   const JSPropertySpec Point::properties[] = {
+//       boilerplate::FieldSpec<&Point::x>("x"),
+//       boilerplate::FieldSpec<&Point::y>("y"), JS_PS_END};
+//   const JSFunctionSpec Point::methods[] = {
+//       boilerplate::MethodSpec<&Point::length>("length"),
+//       boilerplate::MethodSpec<&Point::scale>("scale"), JS_FS_END};
+//
+//   if (!boilerplate::NativeClass<Point>::Define(cx, global)) return false;
+//
+// after which script can do `new Point(3, 4).length()`. Fields and method
+// arguments and return values can have any of the types supported by
+// 'native_binding.h'; ReadOnlyFieldSpec() defines a field without a setter.
+// The constructor arguments are converted the same way and passed to T's
+// constructor. Without a ConstructorArgs type, T is default-constructed.
+//
+// Instances of T are allocated from a pool of fixed-size slots shared by all
+// instances of the class, rather than with one `new` per object. Each object
+// reports sizeof(T) to the GC as associated memory, so that many small objects
+// holding native memory still count towards the GC's heap triggers.
+//
+// The class is finalized in the background, on a GC helper thread, so T's
+// destructor must not call into the JSAPI or touch state owned by the main
+// thread. Freed slots are kept for reuse and not returned to the system.
+
+namespace boilerplate {
+
+namespace detail {
+
+// A free list of fixed-size slots for T, allocated in chunks. Slots are freed
+// from the GC's background finalization threads, so the list is locked.
+template <typename T>
+class NativeClassPool {
+  union Slot {
+    Slot* next;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  static constexpr size_t SlotsPerChunk = 256;
+
+  std::mutex m_lock;
+  Slot* m_free = nullptr;
+  std::vector<std::unique_ptr<Slot[]>> m_chunks;
+
+  bool grow() {
+    std::unique_ptr<Slot[]> chunk(new (std::nothrow) Slot[SlotsPerChunk]);
+    if (!chunk) return false;
+
+    for (size_t i = 0; i < SlotsPerChunk; i++) {
+      chunk[i].next = m_free;
+      m_free = &chunk[i];
+    }
+    m_chunks.push_back(std::move(chunk));
+    return true;
+  }
+
+ public:
+  static NativeClassPool& Get() {
+    static NativeClassPool pool;
+    return pool;
+  }
+
+  void* allocate() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (!m_free && !grow()) return nullptr;
+
+    Slot* slot = m_free;
+    m_free = slot->next;
+    return slot->storage;
+  }
+
+  void release(void* p) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto* slot = reinterpret_cast<Slot*>(p);
+    slot->next = m_free;
+    m_free = slot;
+  }
+};
+
+template <typename T, typename = void>
+struct ConstructorArgsOf {
+  using type = std::tuple<>;
+};
+
+template <typename T>
+struct ConstructorArgsOf<T, std::void_t<typename T::ConstructorArgs>> {
+  using type = typename T::ConstructorArgs;
+};
+
+template <typename T, typename Args = typename ConstructorArgsOf<T>::type>
+struct Constructor;
+
+template <typename T, typename... Args>
+struct Constructor<T, std::tuple<Args...>> {
+  static constexpr unsigned Arity = sizeof...(Args);
+
+  static bool Construct(JSContext* cx, const JS::CallArgs& args, void* mem) {
+    return InvokeWithArgs<void, Args...>(cx, args, [mem](auto&&... values) {
+      new (mem) T(std::forward<decltype(values)>(values)...);
+    });
+  }
+};
+
+}  // namespace detail
+
+template <typename T>
+class NativeClass {
+  enum Slots { PrivateSlot, SlotCount };
+
+  // The GC only needs to know which embedding the memory belongs to.
+  static constexpr JS::MemoryUse Use = JS::MemoryUse::Embedding1;
+
+  using Pool = detail::NativeClassPool<T>;
+  using Ctor = detail::Constructor<T>;
+
+  static bool constructor(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+
+    if (!args.isConstructing()) {
+      JS_ReportErrorNumberASCII(cx, js::GetErrorMessage, nullptr,
+                                JSMSG_CANT_CALL_CLASS_CONSTRUCTOR);
+      return false;
+    }
+
+    JS::RootedObject newObj(cx, JS_NewObjectForConstructor(cx, &klass, args));
+    if (!newObj) return false;
+
+    void* mem = Pool::Get().allocate();
+    if (!mem) {
+      JS_ReportOutOfMemory(cx);
+      return false;
+    }
+
+    // Converting the arguments can run script or fail, so only store the
+    // pointer once T is constructed.
+    if (!Ctor::Construct(cx, args, mem)) {
+      Pool::Get().release(mem);
+      return false;
+    }
+
+    JS::SetReservedSlot(newObj, PrivateSlot, JS::PrivateValue(mem));
+    JS::AddAssociatedMemory(newObj, sizeof(T), Use);
+
+    args.rval().setObject(*newObj);
+    return true;
+  }
+
+  static void finalize(JS::GCContext* gcx, JSObject* obj) {
+    T* priv = Get(obj);
+    if (!priv) return;
+
+    priv->~T();
+    Pool::Get().release(priv);
+    JS::RemoveAssociatedMemory(obj, sizeof(T), Use);
+  }
+
+ public:
+  static constexpr JSClassOps classOps = {
+      nullptr,  // addProperty
+      nullptr,  // deleteProperty
+      nullptr,  // enumerate
+      nullptr,  // newEnumerate
+      nullptr,  // resolve
+      nullptr,  // mayResolve
+      &NativeClass::finalize,
+      nullptr,  // call
+      nullptr,  // construct
+      nullptr,  // trace
+  };
+
+  static constexpr JSClass klass = {
+      T::className,
+      JSCLASS_HAS_RESERVED_SLOTS(SlotCount) | JSCLASS_BACKGROUND_FINALIZE,
+      &NativeClass::classOps,
+  };
+
+  // Define the constructor and prototype on the global object, and return the
+  // prototype.
+  static JSObject* Define(JSContext* cx, JS::HandleObject global) {
+    return JS_InitClass(cx, global, nullptr, nullptr, klass.name,
+                        &NativeClass::constructor, Ctor::Arity, T::properties,
+                        T::methods, nullptr, nullptr);
+  }
+
+  // The C++ object of an instance, or nullptr if obj is not an instance or
+  // construction failed.
+  static T* Get(JSObject* obj) {
+    if (JS::GetClass(obj) != &klass) return nullptr;
+    return JS::GetMaybePtrFromReservedSlot<T>(obj, PrivateSlot);
+  }
+
+  // The C++ object of `this`, or nullptr with an exception pending.
+  static T* UnwrapThis(JSContext* cx, JS::CallArgs& args) {
+    JS::RootedObject thisObj(cx);
+    if (!args.computeThis(cx, &thisObj)) return nullptr;
+    if (!JS_InstanceOf(cx, thisObj, &klass, &args)) return nullptr;
+
+    T* priv = Get(thisObj);
+    if (!priv) {
+      JS_ReportErrorASCII(cx, "%s object is not initialized", klass.name);
+    }
+    return priv;
+  }
+};
+
+namespace detail {
+
+template <auto Member>
+struct FieldBinding;
+
+template <typename C, typename T, T C::*Member>
+struct FieldBinding<Member> {
+  static bool Get(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    C* self = NativeClass<C>::UnwrapThis(cx, args);
+    if (!self) return false;
+    return ReturnConverter<T>::set(cx, self->*Member, args.rval());
+  }
+
+  static bool Set(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    C* self = NativeClass<C>::UnwrapThis(cx, args);
+    if (!self) return false;
+    return InvokeWithArgs<void, T>(
+        cx, args, [self](T value) { self->*Member = std::move(value); });
+  }
+};
+
+template <auto Method>
+struct MethodBinding;
+
+template <typename C, typename R, typename... Args>
+struct MethodBindingBase {
+  static constexpr unsigned Arity = sizeof...(Args);
+
+  template <typename F>
+  static bool Call(JSContext* cx, unsigned argc, JS::Value* vp, F&& call) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    C* self = NativeClass<C>::UnwrapThis(cx, args);
+    if (!self) return false;
+    return InvokeWithArgs<R, Args...>(
+        cx, args, [self, &call](auto&&... values) {
+          return call(self, std::forward<decltype(values)>(values)...);
+        });
+  }
+};
+
+template <typename C, typename R, typename... Args, R (C::*Method)(Args...)>
+struct MethodBinding<Method> : MethodBindingBase<C, R, Args...> {
+  static bool Call(JSContext* cx, unsigned argc, JS::Value* vp) {
+    return MethodBindingBase<C, R, Args...>::Call(
+        cx, argc, vp, [](C* self, auto&&... values) {
+          return (self->*Method)(std::forward<decltype(values)>(values)...);
+        });
+  }
+};
+
+template <typename C, typename R, typename... Args,
+          R (C::*Method)(Args...) const>
+struct MethodBinding<Method> : MethodBindingBase<C, R, Args...> {
+  static bool Call(JSContext* cx, unsigned argc, JS::Value* vp) {
+    return MethodBindingBase<C, R, Args...>::Call(
+        cx, argc, vp, [](C* self, auto&&... values) {
+          return (self->*Method)(std::forward<decltype(values)>(values)...);
+        });
+  }
+};
+
+}  // namespace detail
+
+template <auto Member>
+constexpr JSPropertySpec FieldSpec(const char* name,
+                                   unsigned flags = JSPROP_ENUMERATE) {
+  return JS_PSGS(name, detail::FieldBinding<Member>::Get,
+                 detail::FieldBinding<Member>::Set, flags);
+}
+
+template <auto Member>
+constexpr JSPropertySpec ReadOnlyFieldSpec(const char* name,
+                                           unsigned flags = JSPROP_ENUMERATE) {
+  return JS_PSG(name, detail::FieldBinding<Member>::Get, flags);
+}
+
+template <auto Method>
+constexpr JSFunctionSpec MethodSpec(const char* name,
+                                    unsigned flags = JSPROP_ENUMERATE) {
+  return JS_FN(name, detail::MethodBinding<Method>::Call,
+               detail::MethodBinding<Method>::Arity, flags);
+}
+
+}  // namespace boilerplate
@@ -0,0 +1,49 @@
+#include <jsapi.h>
+#include <js/Id.h>
+#include <js/String.h>
+
+#include "property_keys.h"
+
+// A table of property keys, atomized once, for C++ code that accesses the same
+// properties over and over.
+//
+// Functions like JS_GetProperty() take the property name as a C string, and
+// have to atomize it (hash it and look it up in the atoms table) on every call
+// before they can do the actual lookup. With this table, the names listed in
+// BOILERPLATE_FOR_EACH_PROPERTY_KEY are atomized and pinned once, by
+// InitPropertyKeys(), and then boilerplate::GetProperty() and friends go
+// straight to the *ById() functions:
+//
+//   if (!boilerplate::GetProperty(cx, global, boilerplate::Key::WebAssembly,
+//                                 &wasm))
+//     return false;
+//
+// Atoms belong to a runtime, and each thread has its own context and runtime,
+// so the table is per thread. Call InitPropertyKeys() on each thread after
+// creating its context, and ResetPropertyKeys() before destroying the context;
+// calling InitPropertyKeys() again in between does nothing.
+
+thread_local JS::PropertyKey
+    boilerplate::detail::propertyKeys[size_t(Key::Count)];
+
+static thread_local bool s_keysInitialized = false;
+
+bool boilerplate::InitPropertyKeys(JSContext* cx) {
+  if (s_keysInitialized) return true;
+
+  for (size_t i = 0; i < size_t(Key::Count); i++) {
+    JSString* atom = JS_AtomizeAndPinString(cx, KeyNames[i]);
+    if (!atom) return false;
+    detail::propertyKeys[i] = JS::PropertyKey::fromPinnedString(atom);
+  }
+
+  s_keysInitialized = true;
+  return true;
+}
+
+// Forget the keys of the context that is about to be destroyed, so that the
+// next context on the thread gets its own.
+void boilerplate::ResetPropertyKeys(JSContext* cx) {
+  for (JS::PropertyKey& key : detail::propertyKeys) key = JS::PropertyKey();
+  s_keysInitialized = false;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+
+#include <jsapi.h>
+#include <js/Id.h>
+#include <js/PropertyDescriptor.h>
+#include <js/RootingAPI.h>
+#include <js/Value.h>
+
+// See 'property_keys.cpp' for documentation.
+
+// The property names that C++ code in these examples looks up often. Add a
+// name here to get a pre-atomized key for it: MACRO(identifier, "name").
+#define BOILERPLATE_FOR_EACH_PROPERTY_KEY(MACRO) \
+  MACRO(Instance, "Instance")                    \
+  MACRO(Module, "Module")                        \
+  MACRO(Person, "Person")                        \
+  MACRO(String, "String")                        \
+  MACRO(WebAssembly, "WebAssembly")              \
+  MACRO(checksum, "checksum")                    \
+  MACRO(env, "env")                              \
+  MACRO(exports, "exports")                      \
+  MACRO(myprop, "myprop")                        \
+  MACRO(prototype, "prototype")                  \
+  MACRO(update, "update")
+
+namespace boilerplate {
+
+enum class Key : size_t {
+#define DECLARE_KEY(id, name) id,
+  BOILERPLATE_FOR_EACH_PROPERTY_KEY(DECLARE_KEY)
+#undef DECLARE_KEY
+      Count
+};
+
+constexpr const char* KeyNames[] = {
+#define KEY_NAME(id, name) name,
+    BOILERPLATE_FOR_EACH_PROPERTY_KEY(KEY_NAME)
+#undef KEY_NAME
+};
+
+static_assert(sizeof(KeyNames) / sizeof(KeyNames[0]) == size_t(Key::Count));
+
+bool InitPropertyKeys(JSContext* cx);
+void ResetPropertyKeys(JSContext* cx);
+
+namespace detail {
+extern thread_local JS::PropertyKey propertyKeys[size_t(Key::Count)];
+}
+
+// The keys are atoms pinned for the lifetime of the runtime, which the GC
+// never moves or collects, so they are safe to use as handles without rooting.
+inline JS::HandleId KeyId(Key key) {
+  return JS::HandleId::fromMarkedLocation(
+      &detail::propertyKeys[size_t(key)]);
+}
+
+inline bool GetProperty(JSContext* cx, JS::HandleObject obj, Key key,
+                        JS::MutableHandleValue vp) {
+  return JS_GetPropertyById(cx, obj, KeyId(key), vp);
+}
+
+inline bool SetProperty(JSContext* cx, JS::HandleObject obj, Key key,
+                        JS::HandleValue v) {
+  return JS_SetPropertyById(cx, obj, KeyId(key), v);
+}
+
+inline bool HasProperty(JSContext* cx, JS::HandleObject obj, Key key,
+                        bool* found) {
+  return JS_HasPropertyById(cx, obj, KeyId(key), found);
+}
+
+inline bool DefineProperty(JSContext* cx, JS::HandleObject obj, Key key,
+                           JS::HandleValue v, unsigned attrs) {
+  return JS_DefinePropertyById(cx, obj, KeyId(key), v, attrs);
+}
+
+// Whether 'id' is the given key. Atoms are unique, so this is a pointer
+// comparison instead of a string comparison.
+inline bool IsKey(JS::HandleId id, Key key) {
+  return id == detail::propertyKeys[size_t(key)];
+}
+
+}  // namespace boilerplate
@@ -0,0 +1,134 @@
+#include <jsapi.h>
+#include <jsfriendapi.h>
+#include <js/Realm.h>
+
+#include "boilerplate.h"
+#include "realm_pool.h"
+
+// A pool of fresh globals, for embeddings that isolate each request in its own
+// realm.
+//
+// Creating a global allocates a realm and initializes its standard classes,
+// which is most of the cost of a small request. The pool keeps a few globals
+// ready, so acquire() usually just hands one out, and release() only queues
+// the used one. The work of creating replacements and discarding used globals
+// is done by maintain(), which the embedding calls when it is idle, for
+// example after sending a response and before waiting for the next request.
+// maintain() stops after the given time budget and picks up where it left off
+// on the next call.
+//
+// Globals have to be created on the thread of the context that uses them, and
+// a realm can't be reused once script has run in it: there is no way to undo
+// what the script did to its global and the standard objects. So "background"
+// here means outside of the request's critical path, and recycling means
+// replacing.
+//
+// Discarding a global drops the pool's root, so that the GC can collect the
+// realm, and by default nukes the cross-compartment wrappers into and out of
+// it, so that a reference that leaked into another realm can't keep the whole
+// realm alive. maintain() finishes with JS_MaybeGC(), which lets the GC
+// collect the discarded realms incrementally if it's worth doing.
+//
+// Each realm normally gets its own compartment and zone. Placement changes
+// that:
+// - SharedZone puts all the realms in one zone. Their GC things share arenas,
+//   which saves memory per realm, and there are fewer zones for the GC to
+//   visit, but the zone can only be collected as a whole.
+// - SharedCompartment also puts them in one compartment. Script in the realms
+//   can then use each other's objects directly, without wrappers, so this is
+//   only for realms that trust each other; it isolates requests from each
+//   other's global variables, not from a malicious script.
+//
+// The pool holds persistent roots, so it must be destroyed before its context.
+
+boilerplate::RealmPool::RealmPool(JSContext* cx, const Options& options)
+    : m_cx(cx),
+      m_options(options),
+      m_anchor(cx),
+      m_spares(cx),
+      m_retired(cx) {}
+
+// Create the zone or compartment to share, if any, and the initial spares.
+bool boilerplate::RealmPool::init() {
+  if (m_options.placement != Placement::NewZone) {
+    JS::RealmOptions options;
+    options.creationOptions().setNewCompartmentAndZone();
+    m_anchor = CreateGlobal(m_cx, options);
+    if (!m_anchor) return false;
+  }
+
+  while (m_spares.length() < m_options.spares) {
+    JSObject* global = createGlobal();
+    if (!global || !m_spares.append(global)) return false;
+  }
+  return true;
+}
+
+JSObject* boilerplate::RealmPool::createGlobal() {
+  JS::RealmOptions options;
+  switch (m_options.placement) {
+    case Placement::NewZone:
+      options.creationOptions().setNewCompartmentAndZone();
+      break;
+    case Placement::SharedZone:
+      options.creationOptions().setNewCompartmentInExistingZone(m_anchor);
+      break;
+    case Placement::SharedCompartment:
+      options.creationOptions().setExistingCompartment(m_anchor);
+      break;
+  }
+
+  JSObject* global = CreateGlobal(m_cx, options);
+  if (global) m_stats.created++;
+  return global;
+}
+
+// Get a fresh global for a request, creating one if no spare is ready. Returns
+// nullptr if a global could not be created.
+JSObject* boilerplate::RealmPool::acquire() {
+  m_stats.acquired++;
+  if (!m_spares.empty()) return m_spares.popCopy();
+
+  m_stats.misses++;
+  return createGlobal();
+}
+
+// Give back a global that is no longer used. It is discarded by the next call
+// to maintain().
+void boilerplate::RealmPool::release(JSObject* global) {
+  if (!m_retired.append(global)) discard(global);
+}
+
+void boilerplate::RealmPool::discard(JSObject* global) {
+  if (m_options.nukeWrappers &&
+      m_options.placement != Placement::SharedCompartment) {
+    js::NukeCrossCompartmentWrappers(m_cx, js::AllCompartments(),
+                                     JS::GetObjectRealmOrNull(global),
+                                     js::NukeWindowReferences,
+                                     js::NukeAllReferences);
+  }
+  m_stats.discarded++;
+}
+
+// Discard released globals and create spares, for up to about 'budget'.
+// Returns false if a global could not be created.
+bool boilerplate::RealmPool::maintain(Clock::duration budget) {
+  Clock::time_point now = Clock::now();
+  Clock::time_point deadline = budget < Clock::time_point::max() - now
+                                   ? now + budget
+                                   : Clock::time_point::max();
+
+  while (!m_retired.empty()) {
+    discard(m_retired.popCopy());
+    if (Clock::now() >= deadline) return true;
+  }
+
+  while (m_spares.length() < m_options.spares) {
+    JSObject* global = createGlobal();
+    if (!global || !m_spares.append(global)) return false;
+    if (Clock::now() >= deadline) return true;
+  }
+
+  JS_MaybeGC(m_cx);
+  return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include <jsapi.h>
+#include <js/AllocPolicy.h>
+#include <js/GCVector.h>
+#include <js/RootingAPI.h>
+
+// See 'realm_pool.cpp' for documentation.
+
+namespace boilerplate {
+
+class RealmPool {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // Where the pool's realms are created.
+  enum class Placement {
+    NewZone,            // each realm in its own compartment and zone
+    SharedZone,         // each realm in its own compartment, in one zone
+    SharedCompartment,  // all realms in one compartment
+  };
+
+  struct Options {
+    // Globals to keep ready for acquire().
+    size_t spares = 4;
+    Placement placement = Placement::NewZone;
+    // Nuke the wrappers into and out of discarded realms. Has no effect with
+    // SharedCompartment, which needs no wrappers between the pool's realms.
+    bool nukeWrappers = true;
+  };
+
+  struct Stats {
+    uint64_t created = 0;
+    uint64_t acquired = 0;
+    uint64_t misses = 0;  // acquire() calls that found no spare
+    uint64_t discarded = 0;
+  };
+
+  explicit RealmPool(JSContext* cx) : RealmPool(cx, Options()) {}
+  RealmPool(JSContext* cx, const Options& options);
+
+  RealmPool(const RealmPool&) = delete;
+  RealmPool& operator=(const RealmPool&) = delete;
+
+  bool init();
+
+  JSObject* acquire();
+  void release(JSObject* global);
+  bool maintain(Clock::duration budget);
+
+  size_t spareCount() const { return m_spares.length(); }
+  size_t retiredCount() const { return m_retired.length(); }
+  const Stats& stats() const { return m_stats; }
+
+ private:
+  using GlobalVector = JS::GCVector<JSObject*, 8, js::SystemAllocPolicy>;
+
+  JSObject* createGlobal();
+  void discard(JSObject* global);
+
+  JSContext* m_cx;
+  Options m_options;
+  Stats m_stats;
+
+  // The first global of a shared zone or compartment, which keeps it alive.
+  JS::PersistentRooted<JSObject*> m_anchor;
+  JS::PersistentRooted<GlobalVector> m_spares;
+  JS::PersistentRooted<GlobalVector> m_retired;
+};
+
+}  // namespace boilerplate
@@ -1,21 +1,38 @@
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
 #include <codecvt>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
 #include <iostream>
 #include <locale>
+#include <map>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <vector>
+
+#include <poll.h>
 
 #include <jsapi.h>
 #include <jsfriendapi.h>
 
 #include <mozilla/Unused.h>
 
+#include <js/CallAndConstruct.h>
 #include <js/CompilationAndEvaluation.h>
 #include <js/Conversions.h>
 #include <js/ErrorReport.h>
 #include <js/Exception.h>
+#include <js/GCAPI.h>
+#include <js/GCVector.h>
 #include <js/Initialization.h>
 #include <js/Object.h>
+#include <js/SliceBudget.h>
 #include <js/SourceText.h>
 #include <js/Warnings.h>
 
@@ -23,6 +40,8 @@
 #include <readline/readline.h>
 
 #include "boilerplate.h"
+#include "gc_stats.h"
+#include "string_bridge.h"
 
 /* This is a longer example that illustrates how to build a simple
  * REPL (Read-Eval-Print Loop). */
@@ -31,12 +50,213 @@
  * stdout and stderr. On Linux and macOS this will usually be the case. On
  * Windows you may have to set your terminal's codepage to UTF-8. */
 
+/* Tracks just enough of the lexical structure of the input - brackets,
+ * strings, template literals, comments and regular expressions - to tell, one
+ * line at a time, that the input so far can't be a complete unit yet.
+ *
+ * JS_Utf8BufferIsCompilableUnit() parses the whole buffer, so calling it after
+ * every line makes pasting a long function quadratic. The scanner only looks at
+ * each line once, and the full check is only needed when it says the unit may
+ * be complete, which for most code is at the end of a top-level statement.
+ * The scanner doesn't need to be exact, since the full check has the final
+ * word; it just must not say a unit is incomplete when it isn't. It can get
+ * confused by a slash that it takes for the start of a regular expression (or
+ * the other way round), so two empty lines in a row always force the full
+ * check. */
+class InputScanner {
+  enum class Mode { Code, SingleQuote, DoubleQuote, BlockComment, Regex,
+                    RegexClass };
+
+  Mode m_mode = Mode::Code;
+  // Open brackets, and '`' for template literal text or '$' for a
+  // substitution in one.
+  std::vector<char> m_nesting;
+  std::string m_word;
+  bool m_regexAllowed = true;
+  bool m_error = false;
+
+  static bool IsWordChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' ||
+           c == '$' || (c & 0x80);
+  }
+
+  // Whether a slash after this word starts a regular expression rather than
+  // being a division.
+  static bool RegexMayFollow(const std::string& word) {
+    static const char* keywords[] = {
+        "await", "case",  "delete", "do",   "else",  "in",   "instanceof",
+        "new",   "of",    "return", "throw", "typeof", "void", "yield"};
+    for (const char* keyword : keywords) {
+      if (word == keyword) return true;
+    }
+    return false;
+  }
+
+ public:
+  // Whether the input so far might be a complete unit (or a syntax error,
+  // which is for the full check to report).
+  bool mayBeComplete() const {
+    return m_error || (m_mode == Mode::Code && m_nesting.empty());
+  }
+
+  void scan(std::string_view line);
+};
+
+void InputScanner::scan(std::string_view line) {
+  bool continued = false;  // the line ends with a backslash in a string
+
+  for (size_t i = 0; i < line.size(); i++) {
+    char c = line[i];
+    char next = i + 1 < line.size() ? line[i + 1] : '\0';
+
+    switch (m_mode) {
+      case Mode::BlockComment:
+        if (c == '*' && next == '/') {
+          m_mode = Mode::Code;
+          i++;
+        }
+        continue;
+      case Mode::SingleQuote:
+      case Mode::DoubleQuote:
+        if (c == '\\') {
+          continued = ++i == line.size();
+        } else if (c == (m_mode == Mode::SingleQuote ? '\'' : '"')) {
+          m_mode = Mode::Code;
+          m_regexAllowed = false;
+        }
+        continue;
+      case Mode::Regex:
+        if (c == '\\') {
+          i++;
+        } else if (c == '[') {
+          m_mode = Mode::RegexClass;
+        } else if (c == '/') {
+          m_mode = Mode::Code;
+          m_regexAllowed = false;
+        }
+        continue;
+      case Mode::RegexClass:
+        if (c == '\\') {
+          i++;
+        } else if (c == ']') {
+          m_mode = Mode::Regex;
+        }
+        continue;
+      case Mode::Code:
+        break;
+    }
+
+    if (!m_nesting.empty() && m_nesting.back() == '`') {
+      if (c == '\\') {
+        i++;
+      } else if (c == '`') {
+        m_nesting.pop_back();
+        m_regexAllowed = false;
+      } else if (c == '$' && next == '{') {
+        m_nesting.push_back('$');
+        m_regexAllowed = true;
+        i++;
+      }
+      continue;
+    }
+
+    if (IsWordChar(c)) {
+      if (i == 0 || !IsWordChar(line[i - 1])) m_word.clear();
+      m_word += c;
+      if (!IsWordChar(next)) m_regexAllowed = RegexMayFollow(m_word);
+      continue;
+    }
+
+    switch (c) {
+      case ' ':
+      case '\t':
+      case '\r':
+        break;
+      case '\'':
+        m_mode = Mode::SingleQuote;
+        break;
+      case '"':
+        m_mode = Mode::DoubleQuote;
+        break;
+      case '`':
+        m_nesting.push_back('`');
+        break;
+      case '/':
+        if (next == '/') {
+          i = line.size();
+        } else if (next == '*') {
+          m_mode = Mode::BlockComment;
+          i++;
+        } else if (m_regexAllowed) {
+          m_mode = Mode::Regex;
+        } else {
+          m_regexAllowed = true;
+        }
+        break;
+      case '(':
+      case '[':
+      case '{':
+        m_nesting.push_back(c);
+        m_regexAllowed = true;
+        break;
+      case ')':
+      case ']':
+      case '}': {
+        char open = c == ')' ? '(' : c == ']' ? '[' : '{';
+        if (m_nesting.empty() ||
+            (m_nesting.back() != open &&
+             !(c == '}' && m_nesting.back() == '$'))) {
+          m_error = true;
+        } else {
+          m_nesting.pop_back();
+        }
+        // A slash after a block is a regular expression, after an object
+        // literal a division; guess the former.
+        m_regexAllowed = c == '}';
+        break;
+      }
+      default:
+        m_regexAllowed = true;
+        break;
+    }
+  }
+
+  // Strings and regular expressions can't span lines, except for a string
+  // with an escaped newline.
+  if (((m_mode == Mode::SingleQuote || m_mode == Mode::DoubleQuote) &&
+       !continued) ||
+      m_mode == Mode::Regex || m_mode == Mode::RegexClass) {
+    m_mode = Mode::Code;
+    m_error = true;
+  }
+}
+
 class ReplGlobal {
-  enum Slots { GlobalSlot, SlotCount };
+  enum Slots { GlobalSlot, TimersSlot, SlotCount };
+
+  using Clock = std::chrono::steady_clock;
+  using FunctionVector = JS::GCVector<JSFunction*, 0, js::SystemAllocPolicy>;
 
   bool m_shouldQuit : 1;
+  bool m_eof : 1;
+
+  // The unit being typed in.
+  std::string m_buffer;
+  InputScanner m_scanner;
+  unsigned m_lineno = 1;
+  unsigned m_startline = 1;
+  unsigned m_emptyLines = 0;
+
+  // Pending timeouts by deadline. The callbacks are kept in an object in
+  // TimersSlot, keyed by timer ID, so that the global keeps them alive.
+  std::multimap<Clock::time_point, uint32_t> m_timers;
+  uint32_t m_nextTimerId = 1;
+
+  // FinalizationRegistry cleanup callbacks queued by the GC.
+  JS::PersistentRooted<FunctionVector> m_cleanupCallbacks;
 
-  ReplGlobal(void) : m_shouldQuit(false) {}
+  explicit ReplGlobal(JSContext* cx)
+      : m_shouldQuit(false), m_eof(false), m_cleanupCallbacks(cx) {}
 
   static ReplGlobal* priv(JSObject* global) {
     auto* retval = JS::GetMaybePtrFromReservedSlot<ReplGlobal>(global, GlobalSlot);
@@ -57,14 +277,34 @@ class ReplGlobal {
     return false;
   }
 
+  static bool print(JSContext* cx, unsigned argc, JS::Value* vp);
+  static bool setTimeout(JSContext* cx, unsigned argc, JS::Value* vp);
+  static bool clearTimeout(JSContext* cx, unsigned argc, JS::Value* vp);
+
+  static void cleanupFinalizationRegistry(JSFunction* callback,
+                                          JSObject* incumbentGlobal,
+                                          void* data);
+
+  void processLines(JSContext* cx, JS::HandleObject global);
+  void processLine(JSContext* cx, JS::HandleObject global,
+                   std::string_view line);
+  void evaluate(JSContext* cx, JS::HandleObject global);
+  bool hasPendingWork() const;
+  void runPendingWork(JSContext* cx, JS::HandleObject global);
+  bool fireTimer(JSContext* cx, JS::HandleObject global, uint32_t id);
+
   static const JSClass klass;
 
   static constexpr JSFunctionSpec functions[] = {
-      JS_FN("quit", &ReplGlobal::quit, 0, 0), JS_FS_END};
+      JS_FN("quit", &ReplGlobal::quit, 0, 0),
+      JS_FN("print", &ReplGlobal::print, 0, 0),
+      JS_FN("setTimeout", &ReplGlobal::setTimeout, 2, 0),
+      JS_FN("clearTimeout", &ReplGlobal::clearTimeout, 1, 0), JS_FS_END};
 
  public:
   static JSObject* create(JSContext* cx);
   static void loop(JSContext* cx, JS::HandleObject global);
+  static void destroy(JSContext* cx, JSObject* global);
 };
 constexpr JSFunctionSpec ReplGlobal::functions[];
 
@@ -78,13 +318,13 @@ const JSClass ReplGlobal::klass = {
 std::string FormatString(JSContext* cx, JS::HandleString string) {
   std::string buf = "\"";
 
-  JS::UniqueChars chars(JS_EncodeStringToUTF8(cx, string));
-  if (!chars) {
+  std::string_view chars;
+  if (!boilerplate::EncodeUTF8(cx, string, &chars)) {
     JS_ClearPendingException(cx);
     return "[invalid string]";
   }
 
-  buf += chars.get();
+  buf += chars;
   buf += '"';
   return buf;
 }
@@ -123,31 +363,130 @@ std::string FormatResult(JSContext* cx, JS::HandleValue value) {
     return "[invalid class]";
   }
 
-  JS::UniqueChars bytes(JS_EncodeStringToUTF8(cx, str));
-  if (!bytes) {
+  std::string_view bytes;
+  if (!boilerplate::EncodeUTF8(cx, str, &bytes)) {
     JS_ClearPendingException(cx);
     return "[invalid string]";
   }
 
-  return bytes.get();
+  return std::string(bytes);
 }
 
 JSObject* ReplGlobal::create(JSContext* cx) {
   JS::RealmOptions options;
+  options.creationOptions().setWeakRefsEnabled(
+      JS::WeakRefSpecifier::EnabledWithoutCleanupSome);
   JS::RootedObject global(cx,
                           JS_NewGlobalObject(cx, &ReplGlobal::klass, nullptr,
                                              JS::FireOnNewGlobalHook, options));
+  if (!global) return nullptr;
 
-  ReplGlobal* priv = new ReplGlobal();
+  ReplGlobal* priv = new ReplGlobal(cx);
   JS::SetReservedSlot(global, GlobalSlot, JS::PrivateValue(priv));
 
+  // Without this, FinalizationRegistry callbacks are never called.
+  JS::SetHostCleanupFinalizationRegistryCallback(
+      cx, &ReplGlobal::cleanupFinalizationRegistry, priv);
+
   // Define any extra global functions that we want in our environment.
   JSAutoRealm ar(cx, global);
   if (!JS_DefineFunctions(cx, global, ReplGlobal::functions)) return nullptr;
 
+  JSObject* timers = JS_NewPlainObject(cx);
+  if (!timers) return nullptr;
+  JS::SetReservedSlot(global, TimersSlot, JS::ObjectValue(*timers));
+
   return global;
 }
 
+void ReplGlobal::destroy(JSContext* cx, JSObject* global) {
+  JS::SetHostCleanupFinalizationRegistryCallback(cx, nullptr, nullptr);
+  delete priv(global);
+  JS::SetReservedSlot(global, GlobalSlot, JS::UndefinedValue());
+}
+
+bool ReplGlobal::print(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+
+  for (unsigned i = 0; i < args.length(); i++) {
+    JS::RootedString str(cx, JS::ToString(cx, args[i]));
+    if (!str) return false;
+
+    std::string_view chars;
+    if (!boilerplate::EncodeUTF8(cx, str, &chars)) return false;
+    if (i > 0) std::cout << ' ';
+    std::cout << chars;
+  }
+  // Flush, since this may be called while waiting for input.
+  std::cout << std::endl;
+
+  args.rval().setUndefined();
+  return true;
+}
+
+bool ReplGlobal::setTimeout(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  if (!args.requireAtLeast(cx, "setTimeout", 1)) return false;
+  if (!args[0].isObject() || !JS::IsCallable(&args[0].toObject())) {
+    JS_ReportErrorASCII(cx, "setTimeout: callback is not a function");
+    return false;
+  }
+
+  double delay = 0;
+  if (args.length() > 1 && !JS::ToNumber(cx, args[1], &delay)) return false;
+  // Negative and NaN delays mean no delay, as in browsers.
+  if (!(delay > 0)) delay = 0;
+  delay = std::min(delay, double(INT32_MAX));
+
+  JS::RootedObject global(cx, JS::GetNonCCWObjectGlobal(&args.callee()));
+  JS::RootedObject timers(cx,
+                          &JS::GetReservedSlot(global, TimersSlot).toObject());
+  ReplGlobal* repl = priv(global);
+
+  uint32_t id = repl->m_nextTimerId++;
+  if (!JS_SetElement(cx, timers, id, args[0])) return false;
+
+  Clock::time_point deadline =
+      Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                         std::chrono::duration<double, std::milli>(delay));
+  repl->m_timers.emplace(deadline, id);
+
+  args.rval().setNumber(id);
+  return true;
+}
+
+bool ReplGlobal::clearTimeout(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+
+  double id = 0;
+  if (args.length() > 0 && !JS::ToNumber(cx, args[0], &id)) return false;
+
+  JS::RootedObject global(cx, JS::GetNonCCWObjectGlobal(&args.callee()));
+  JS::RootedObject timers(cx,
+                          &JS::GetReservedSlot(global, TimersSlot).toObject());
+  ReplGlobal* repl = priv(global);
+
+  for (auto entry = repl->m_timers.begin(); entry != repl->m_timers.end();
+       ++entry) {
+    if (entry->second == id) {
+      if (!JS_DeleteElement(cx, timers, entry->second)) return false;
+      repl->m_timers.erase(entry);
+      break;
+    }
+  }
+
+  args.rval().setUndefined();
+  return true;
+}
+
+// Called during GC, so only queue the callback; runPendingWork() calls it.
+void ReplGlobal::cleanupFinalizationRegistry(JSFunction* callback,
+                                             JSObject* incumbentGlobal,
+                                             void* data) {
+  auto* repl = static_cast<ReplGlobal*>(data);
+  mozilla::Unused << repl->m_cleanupCallbacks.append(callback);
+}
+
 bool EvalAndPrint(JSContext* cx, const std::string& buffer, unsigned lineno) {
   JS::CompileOptions options(cx);
   options.setFileAndLine("typein", lineno);
@@ -170,43 +509,257 @@ bool EvalAndPrint(JSContext* cx, const std::string& buffer, unsigned lineno) {
   return true;
 }
 
-void ReplGlobal::loop(JSContext* cx, JS::HandleObject global) {
-  bool eof = false;
-  unsigned lineno = 1;
-  do {
-    // Accumulate lines until we get a 'compilable unit' - one that either
-    // generates an error (before running out of source) or that compiles
-    // cleanly.  This should be whenever we get a complete statement that
-    // coincides with the end of a line.
-    unsigned startline = lineno;
-    std::string buffer;
-
-    do {
-      const char* prompt = startline == lineno ? "js> " : "... ";
-      char* line = readline(prompt);
-      if (!line) {
-        eof = true;
-        break;
-      }
-      if (line[0] != '\0') add_history(line);
-      buffer += line;
-      lineno++;
-    } while (!JS_Utf8BufferIsCompilableUnit(cx, global, buffer.c_str(),
-                                            buffer.length()));
-
-    if (!EvalAndPrint(cx, buffer, startline)) {
-      if (!priv(global)->m_shouldQuit) {
+// Lines that readline has finished, waiting for the event loop; nullptr
+// stands for the end of input. The callback interface of readline only takes a
+// plain function, so these are not members of ReplGlobal.
+static std::deque<char*> s_lines;
+static bool s_reading = false;
+
+static void OnLine(char* line) {
+  s_lines.push_back(line);
+  // Don't prompt for the next line until this one has been evaluated.
+  rl_callback_handler_remove();
+  s_reading = false;
+}
+
+// While waiting for input, clear the prompt and the line being edited so that
+// callbacks can print, and put them back afterwards.
+class AutoHidePrompt {
+  char* m_line = nullptr;
+  int m_point = 0;
+
+ public:
+  AutoHidePrompt() {
+    if (!s_reading) return;
+    m_line = rl_copy_text(0, rl_end);
+    m_point = rl_point;
+    rl_save_prompt();
+    rl_replace_line("", 0);
+    rl_redisplay();
+  }
+
+  ~AutoHidePrompt() {
+    if (!m_line) return;
+    rl_restore_prompt();
+    rl_replace_line(m_line, 0);
+    rl_point = m_point;
+    rl_redisplay();
+    free(m_line);
+  }
+};
+
+// Run the unit that has been typed in, and start a new one.
+void ReplGlobal::evaluate(JSContext* cx, JS::HandleObject global) {
+  if (!EvalAndPrint(cx, m_buffer, m_startline)) {
+    if (!m_shouldQuit) {
+      boilerplate::ReportAndClearException(cx);
+    }
+  }
+
+  js::RunJobs(cx);
+
+  m_buffer.clear();
+  m_scanner = InputScanner();
+  m_startline = m_lineno;
+  m_emptyLines = 0;
+}
+
+// Accumulate lines until we get a 'compilable unit' - one that either
+// generates an error (before running out of source) or that compiles cleanly.
+// This should be whenever we get a complete statement that coincides with the
+// end of a line.
+//
+// The full check parses the whole buffer, so it is only done when the scanner
+// says the unit may be complete.
+void ReplGlobal::processLine(JSContext* cx, JS::HandleObject global,
+                             std::string_view line) {
+  if (line.empty()) {
+    m_emptyLines++;
+  } else {
+    m_emptyLines = 0;
+  }
+  m_buffer += line;
+  m_buffer += '\n';
+  m_scanner.scan(line);
+  m_lineno++;
+
+  bool check = m_scanner.mayBeComplete() || m_emptyLines >= 2;
+  if (check && JS_Utf8BufferIsCompilableUnit(cx, global, m_buffer.c_str(),
+                                             m_buffer.length())) {
+    evaluate(cx, global);
+  }
+}
+
+void ReplGlobal::processLines(JSContext* cx, JS::HandleObject global) {
+  while (!s_lines.empty() && !m_shouldQuit) {
+    char* line = s_lines.front();
+    s_lines.pop_front();
+
+    if (!line) {
+      m_eof = true;
+      if (!m_buffer.empty()) evaluate(cx, global);
+      continue;
+    }
+
+    if (line[0] != '\0') add_history(line);
+
+    // A bracketed paste arrives as one line with the newlines in it.
+    std::string_view rest(line);
+    size_t end;
+    while ((end = rest.find('\n')) != std::string_view::npos) {
+      processLine(cx, global, rest.substr(0, end));
+      rest.remove_prefix(end + 1);
+    }
+    processLine(cx, global, rest);
+    free(line);
+  }
+}
+
+bool ReplGlobal::hasPendingWork() const {
+  return !m_cleanupCallbacks.empty() ||
+         (!m_timers.empty() && m_timers.begin()->first <= Clock::now());
+}
+
+bool ReplGlobal::fireTimer(JSContext* cx, JS::HandleObject global,
+                           uint32_t id) {
+  JS::RootedObject timers(cx,
+                          &JS::GetReservedSlot(global, TimersSlot).toObject());
+  JS::RootedValue callback(cx);
+  if (!JS_GetElement(cx, timers, id, &callback) ||
+      !JS_DeleteElement(cx, timers, id)) {
+    return false;
+  }
+
+  JS::RootedValue rval(cx);
+  return JS_CallFunctionValue(cx, nullptr, callback,
+                              JS::HandleValueArray::empty(), &rval);
+}
+
+// Run the FinalizationRegistry cleanup callbacks and the timeouts that are due,
+// each followed by the promise jobs it queued.
+void ReplGlobal::runPendingWork(JSContext* cx, JS::HandleObject global) {
+  while (!m_cleanupCallbacks.empty() && !m_shouldQuit) {
+    JS::Rooted<FunctionVector> callbacks(cx);
+    std::swap(callbacks.get(), m_cleanupCallbacks.get());
+    for (JSFunction* f : callbacks) {
+      JS::ExposeObjectToActiveJS(JS_GetFunctionObject(f));
+
+      JS::RootedFunction func(cx, f);
+      JS::RootedValue rval(cx);
+      if (!JS_CallFunction(cx, nullptr, func, JS::HandleValueArray::empty(),
+                           &rval) &&
+          !m_shouldQuit) {
         boilerplate::ReportAndClearException(cx);
       }
     }
+    js::RunJobs(cx);
+  }
 
+  // Timeouts that are added meanwhile wait for the next turn, so that a
+  // callback that keeps adding zero timeouts can't starve the input.
+  Clock::time_point now = Clock::now();
+  while (!m_timers.empty() && m_timers.begin()->first <= now &&
+         !m_shouldQuit) {
+    uint32_t id = m_timers.begin()->second;
+    m_timers.erase(m_timers.begin());
+    if (!fireTimer(cx, global, id) && !m_shouldQuit) {
+      boilerplate::ReportAndClearException(cx);
+    }
     js::RunJobs(cx);
-  } while (!eof && !priv(global)->m_shouldQuit);
+  }
+}
+
+// The event loop. Instead of blocking in readline(), it waits with poll() for
+// input, the next timeout, or the time to collect garbage, whichever comes
+// first, and feeds input to readline a character at a time through its
+// callback interface. So promise jobs, timeouts and FinalizationRegistry
+// callbacks keep running while the user is typing, and their output is printed
+// above the line being edited.
+//
+// After a second without input or script running, the GC gets a chance to run
+// (JS_MaybeGC()), and an incremental GC in progress is finished in short
+// slices, so that it doesn't delay the next evaluation.
+//
+// At the end of input, the loop keeps running until no timeouts are left.
+void ReplGlobal::loop(JSContext* cx, JS::HandleObject global) {
+  static constexpr auto IdleDelay = std::chrono::seconds(1);
+  static constexpr int64_t IdleSliceMs = 10;
+
+  ReplGlobal* repl = priv(global);
+  int fd = fileno(rl_instream ? rl_instream : stdin);
+  Clock::time_point lastActivity = Clock::now();
+  bool idleGCDone = false;
+
+  while (!repl->m_shouldQuit) {
+    if (repl->hasPendingWork()) {
+      AutoHidePrompt hide;
+      repl->runPendingWork(cx, global);
+      lastActivity = Clock::now();
+      idleGCDone = false;
+      continue;
+    }
+    if (repl->m_eof && repl->m_timers.empty()) break;
+
+    if (!repl->m_eof && !s_reading) {
+      rl_callback_handler_install(repl->m_buffer.empty() ? "js> " : "... ",
+                                  OnLine);
+      s_reading = true;
+    }
+
+    Clock::time_point now = Clock::now();
+    Clock::time_point wakeup = Clock::time_point::max();
+    if (!repl->m_timers.empty()) wakeup = repl->m_timers.begin()->first;
+    if (!idleGCDone) {
+      wakeup = std::min(wakeup, lastActivity + IdleDelay);
+    } else if (JS::IsIncrementalGCInProgress(cx)) {
+      wakeup = now;
+    }
+
+    int timeout = -1;
+    if (wakeup != Clock::time_point::max()) {
+      auto ms = std::chrono::ceil<std::chrono::milliseconds>(wakeup - now);
+      timeout = int(std::clamp<int64_t>(ms.count(), 0, INT32_MAX));
+    }
+
+    struct pollfd input = {fd, POLLIN, 0};
+    int ready = poll(&input, repl->m_eof ? 0 : 1, timeout);
+    if (ready < 0) {
+      if (errno == EINTR) continue;
+      perror("poll");
+      break;
+    }
+
+    if (ready > 0) {
+      rl_callback_read_char();
+      repl->processLines(cx, global);
+      lastActivity = Clock::now();
+      idleGCDone = false;
+      continue;
+    }
+
+    if (Clock::now() - lastActivity >= IdleDelay) {
+      if (JS::IsIncrementalGCInProgress(cx)) {
+        JS::PrepareForIncrementalGC(cx);
+        JS::IncrementalGCSlice(cx, JS::GCReason::API,
+                               js::SliceBudget(js::TimeBudget(IdleSliceMs)));
+      } else if (!idleGCDone) {
+        JS_MaybeGC(cx);
+      }
+      idleGCDone = true;
+    }
+  }
+
+  if (s_reading) {
+    rl_callback_handler_remove();
+    s_reading = false;
+  }
+  for (char* line : s_lines) free(line);
+  s_lines.clear();
 }
 
 static bool RunREPL(JSContext* cx) {
   // In order to use Promises in the REPL, we need a job queue to process
-  // events after each line of input is processed.
+  // events after each line of input is processed, and while waiting for more.
   //
   // A more sophisticated embedding would schedule it's own tasks and use
   // JS::SetEnqueuePromiseJobCallback(), JS::SetGetIncumbentGlobalCallback(),
@@ -214,18 +767,25 @@ static bool RunREPL(JSContext* cx) {
   if (!js::UseInternalJobQueues(cx)) return false;
 
   // We must instantiate self-hosting *after* setting up job queue.
-  if (!JS::InitSelfHostedCode(cx)) return false;
+  if (!boilerplate::InitSelfHostedCode(cx)) return false;
+
+  // Let the user look at GC behaviour while experimenting, with gcStats().
+  if (!boilerplate::EnableGCStats(cx)) return false;
 
   JS::RootedObject global(cx, ReplGlobal::create(cx));
   if (!global) return false;
 
   JSAutoRealm ar(cx, global);
+  if (!boilerplate::DefineGCStatsFunction(cx, global)) return false;
 
   JS::SetWarningReporter(cx, [](JSContext* cx, JSErrorReport* report) {
     JS::PrintError(stderr, report, true);
   });
 
   ReplGlobal::loop(cx, global);
+  ReplGlobal::destroy(cx, global);
+  boilerplate::DisableGCStats(cx);
+  boilerplate::ResetStringCaches(cx);
 
   std::cout << '\n';
   return true;
@@ -13,6 +13,8 @@
 #include <js/SourceText.h>
 
 #include "boilerplate.h"
+#include "property_keys.h"
+#include "script_cache.h"
 
 namespace zlib {
 #include <zlib.h>
@@ -111,27 +113,17 @@ class Crc {
   static bool newEnumerate(JSContext* cx, JS::HandleObject obj,
                            JS::MutableHandleIdVector properties,
                            bool enumerableOnly) {
-    jsid idUpdate =
-        JS::PropertyKey::fromPinnedString(JS_AtomizeAndPinString(cx, "update"));
-    if (!properties.append(idUpdate)) return false;
-
-    jsid idChecksum = JS::PropertyKey::fromPinnedString(
-        JS_AtomizeAndPinString(cx, "checksum"));
-    if (!properties.append(idChecksum)) return false;
+    if (!properties.append(boilerplate::KeyId(boilerplate::Key::update)) ||
+        !properties.append(boilerplate::KeyId(boilerplate::Key::checksum))) {
+      return false;
+    }
 
     return true;
   }
 
   static bool resolve(JSContext* cx, JS::HandleObject obj, JS::HandleId id,
                       bool* resolved) {
-    if (!id.isString()) {
-      *resolved = false;
-      return true;
-    }
-
-    JSLinearString* str = id.toLinearString();
-
-    if (JS_LinearStringEqualsAscii(str, "update")) {
+    if (boilerplate::IsKey(id, boilerplate::Key::update)) {
       if (!JS_DefineFunctionById(cx, obj, id, &Crc::update, 1,
                                  JSPROP_ENUMERATE))
         return false;
@@ -139,7 +131,7 @@ class Crc {
       return true;
     }
 
-    if (JS_LinearStringEqualsAscii(str, "checksum")) {
+    if (boilerplate::IsKey(id, boilerplate::Key::checksum)) {
       if (!JS_DefinePropertyById(cx, obj, id, &Crc::getChecksum, nullptr,
                                  JSPROP_ENUMERATE))
         return false;
@@ -191,6 +183,9 @@ class Crc {
 
  public:
   static bool DefinePrototype(JSContext* cx) {
+    // The resolve and enumerate hooks use pre-atomized keys.
+    if (!boilerplate::InitPropertyKeys(cx)) return false;
+
     JS::RootedObject global(cx, JS::CurrentGlobalOrNull(cx));
     return JS_InitClass(cx,
                         global,   // the object in which to define the class
@@ -231,7 +226,7 @@ static bool ExecuteCodePrintResult(JSContext* cx, const char* code) {
   }
 
   JS::RootedValue rval(cx);
-  if (!JS::Evaluate(cx, options, source, &rval)) return false;
+  if (!boilerplate::EvaluateCached(cx, options, source, &rval)) return false;
 
   JS::RootedString rval_str(cx, JS::ToString(cx, rval));
   if (!rval_str) return false;
@@ -279,6 +274,7 @@ static bool ResolveExample(JSContext* cx) {
     return false;
   }
 
+  boilerplate::ResetPropertyKeys(cx);
   return true;
 }
 
@@ -0,0 +1,321 @@
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <string>
+
+#include <unistd.h>
+
+#include <jsapi.h>
+#include <js/CompilationAndEvaluation.h>
+#include <js/Transcoding.h>
+
+#include "mapped_file.h"
+#include "script_cache.h"
+
+// A persistent cache of compiled scripts, so that running the same script again
+// in a later process skips parsing entirely.
+//
+// Scripts are compiled to a JS::Stencil, which is SpiderMonkey's
+// global-independent representation of compiled code. The stencil is then
+// serialized with the transcoding API and written to a file whose name is a
+// hash of the script's contents and compile options. On the next run, the file
+// is mapped into memory and deserialized, and the resulting stencil is
+// instantiated into the current global, which is much cheaper than parsing.
+//
+// The cache is enabled by setting the BOILERPLATE_SCRIPT_CACHE environment
+// variable to an existing directory. If it is not set, EvaluateCached() behaves
+// exactly like JS::Evaluate().
+//
+// Cache files are tagged with the SpiderMonkey version. Clear the directory if
+// SpiderMonkey is rebuilt with other options.
+//
+// Since a stencil doesn't belong to any global, the same stencil can also be
+// instantiated into many globals. boilerplate::StencilCache keeps recently used
+// stencils in memory for that purpose, so that a script that is run in every
+// newly created realm is only compiled once.
+
+namespace {
+
+// Layout of a cache file: this header, followed by the serialized stencil. The
+// header's size keeps the stencil data suitably aligned for decoding.
+struct CacheFileHeader {
+  char magic[8];
+  uint64_t hash;
+  uint64_t sourceLength;
+  uint64_t dataLength;
+};
+
+constexpr char CacheFileMagic[8] = {'S', 'M', 'S', 'T', 'N', 'C', 'L', '1'};
+
+}  // namespace
+
+static_assert(sizeof(CacheFileHeader) % 8 == 0,
+              "stencil data must start at an aligned offset");
+
+// FNV-1a, which is good enough to tell scripts apart for caching purposes.
+static uint64_t HashBytes(uint64_t hash, const void* bytes, size_t length) {
+  const uint8_t* p = static_cast<const uint8_t*>(bytes);
+  for (size_t i = 0; i < length; i++) {
+    hash ^= p[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// Hash everything that affects the compiled result: the SpiderMonkey version,
+// the filename and starting line that are recorded in the compiled code, and
+// the source text.
+uint64_t boilerplate::HashScriptSource(
+    const JS::ReadOnlyCompileOptions& options, const char* units,
+    size_t length) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+
+  const char* version = JS_GetImplementationVersion();
+  hash = HashBytes(hash, version, strlen(version) + 1);
+
+  const char* filename = options.filename() ? options.filename() : "";
+  hash = HashBytes(hash, filename, strlen(filename) + 1);
+
+  uint32_t lineno = options.lineno;
+  hash = HashBytes(hash, &lineno, sizeof(lineno));
+
+  return HashBytes(hash, units, length);
+}
+
+static const char* CacheDirectory() {
+  return getenv("BOILERPLATE_SCRIPT_CACHE");
+}
+
+static std::string CacheFilePath(const char* directory, uint64_t hash) {
+  char name[32];
+  snprintf(name, sizeof(name), "/%016" PRIx64 ".stencil", hash);
+  return std::string(directory) + name;
+}
+
+// Try to load a stencil from a cache file. Returns false only on a pending
+// exception; a missing or unusable cache file leaves 'stencilOut' null.
+static bool ReadCacheFile(JSContext* cx,
+                          const JS::ReadOnlyCompileOptions& options,
+                          const std::string& path, uint64_t hash,
+                          size_t sourceLength,
+                          RefPtr<JS::Stencil>* stencilOut) {
+  boilerplate::MappedFile file;
+  if (!file.map(path.c_str()) || file.size() < sizeof(CacheFileHeader)) {
+    return true;
+  }
+
+  CacheFileHeader header;
+  memcpy(&header, file.data(), sizeof(header));
+  if (memcmp(header.magic, CacheFileMagic, sizeof(CacheFileMagic)) != 0 ||
+      header.hash != hash || header.sourceLength != sourceLength ||
+      header.dataLength != file.size() - sizeof(header)) {
+    return true;
+  }
+
+  JS::DecodeOptions decodeOptions(options);
+  JS::TranscodeRange range(file.data() + sizeof(header),
+                           size_t(header.dataLength));
+
+  RefPtr<JS::Stencil> stencil;
+  JS::TranscodeResult result =
+      JS::DecodeStencil(cx, decodeOptions, range, getter_AddRefs(stencil));
+  if (result == JS::TranscodeResult::Throw) return false;
+  if (result != JS::TranscodeResult::Ok) {
+    // Stale or corrupt; it will be replaced.
+    return true;
+  }
+
+  *stencilOut = std::move(stencil);
+  return true;
+}
+
+static void WriteCacheFile(const std::string& path, uint64_t hash,
+                           size_t sourceLength,
+                           const JS::TranscodeBuffer& buffer) {
+  CacheFileHeader header;
+  memcpy(header.magic, CacheFileMagic, sizeof(CacheFileMagic));
+  header.hash = hash;
+  header.sourceLength = sourceLength;
+  header.dataLength = buffer.length();
+
+  // Write to a temporary file first, so that another thread or process never
+  // maps a partially written cache file.
+  std::string tmpPath = path + ".XXXXXX";
+  int fd = mkstemp(tmpPath.data());
+  if (fd < 0) return;
+  FILE* fp = fdopen(fd, "wb");
+  if (!fp) {
+    close(fd);
+    remove(tmpPath.c_str());
+    return;
+  }
+
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+            fwrite(buffer.begin(), 1, buffer.length(), fp) == buffer.length();
+  ok = fclose(fp) == 0 && ok;
+
+  if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+    fprintf(stderr, "Warning: could not write script cache '%s'\n",
+            path.c_str());
+    remove(tmpPath.c_str());
+  }
+}
+
+// Compile the source to a stencil, going through the on-disk cache if it is
+// enabled. Returns null with an exception pending on failure.
+already_AddRefed<JS::Stencil> boilerplate::CompileStencilWithDiskCache(
+    JSContext* cx, const JS::ReadOnlyCompileOptions& options,
+    JS::SourceText<mozilla::Utf8Unit>& source) {
+  const char* directory = CacheDirectory();
+  if (!directory) {
+    return JS::CompileGlobalScriptToStencil(cx, options, source);
+  }
+
+  const char* units = reinterpret_cast<const char*>(source.get());
+  uint64_t hash = HashScriptSource(options, units, source.length());
+  std::string path = CacheFilePath(directory, hash);
+
+  RefPtr<JS::Stencil> stencil;
+  if (!ReadCacheFile(cx, options, path, hash, source.length(), &stencil)) {
+    return nullptr;
+  }
+  if (stencil) return stencil.forget();
+
+  stencil = JS::CompileGlobalScriptToStencil(cx, options, source);
+  if (!stencil) return nullptr;
+
+  // Failing to write the cache is not an error; we just parse again next time.
+  JS::TranscodeBuffer buffer;
+  if (JS::EncodeStencil(cx, stencil, buffer) == JS::TranscodeResult::Ok) {
+    WriteCacheFile(path, hash, source.length(), buffer);
+  } else {
+    JS_ClearPendingException(cx);
+  }
+
+  return stencil.forget();
+}
+
+// A replacement for JS::Evaluate() that goes through the on-disk cache.
+bool boilerplate::EvaluateCached(JSContext* cx,
+                                 const JS::ReadOnlyCompileOptions& options,
+                                 JS::SourceText<mozilla::Utf8Unit>& source,
+                                 JS::MutableHandleValue rval) {
+  if (!CacheDirectory()) {
+    return JS::Evaluate(cx, options, source, rval);
+  }
+
+  RefPtr<JS::Stencil> stencil =
+      CompileStencilWithDiskCache(cx, options, source);
+  if (!stencil) return false;
+
+  JS::InstantiateOptions instantiateOptions(options);
+  JS::RootedScript script(
+      cx, JS::InstantiateGlobalStencil(cx, instantiateOptions, stencil));
+  if (!script) return false;
+
+  return JS_ExecuteScript(cx, script, rval);
+}
+
+// StencilCache: an in-memory LRU cache of stencils, keyed by the hash of the
+// source and options (see HashScriptSource()) and the filename. It may be
+// shared between contexts on different threads.
+
+already_AddRefed<JS::Stencil> boilerplate::StencilCache::lookup(
+    uint64_t hash, const char* filename) {
+  std::lock_guard<std::mutex> guard(m_lock);
+
+  auto [begin, end] = m_index.equal_range(hash);
+  for (auto it = begin; it != end; ++it) {
+    EntryList::iterator entry = it->second;
+    if (entry->filename != filename) continue;
+
+    m_entries.splice(m_entries.begin(), m_entries, entry);
+    return do_AddRef(entry->stencil);
+  }
+  return nullptr;
+}
+
+void boilerplate::StencilCache::insert(uint64_t hash, const char* filename,
+                                       JS::Stencil* stencil) {
+  std::lock_guard<std::mutex> guard(m_lock);
+
+  // Another thread may have compiled the same script in the meantime; both
+  // stencils are equivalent, so keep the one that is already cached.
+  auto [begin, end] = m_index.equal_range(hash);
+  for (auto it = begin; it != end; ++it) {
+    if (it->second->filename == filename) return;
+  }
+
+  m_entries.push_front(Entry{hash, filename, stencil});
+  m_index.emplace(hash, m_entries.begin());
+
+  while (m_entries.size() > m_capacity) {
+    EntryList::iterator last = std::prev(m_entries.end());
+    auto [evictBegin, evictEnd] = m_index.equal_range(last->hash);
+    for (auto it = evictBegin; it != evictEnd; ++it) {
+      if (it->second == last) {
+        m_index.erase(it);
+        break;
+      }
+    }
+    m_entries.pop_back();
+  }
+}
+
+// Return the cached stencil for this source, compiling it (through the on-disk
+// cache, if enabled) on a miss. Returns null with an exception pending on
+// failure.
+already_AddRefed<JS::Stencil> boilerplate::StencilCache::getOrCompile(
+    JSContext* cx, const JS::ReadOnlyCompileOptions& options,
+    JS::SourceText<mozilla::Utf8Unit>& source) {
+  const char* units = reinterpret_cast<const char*>(source.get());
+  uint64_t hash = HashScriptSource(options, units, source.length());
+  const char* filename = options.filename() ? options.filename() : "";
+
+  if (RefPtr<JS::Stencil> stencil = lookup(hash, filename)) {
+    return stencil.forget();
+  }
+
+  // Compile without holding the lock, so that other threads can still use the
+  // cache meanwhile.
+  RefPtr<JS::Stencil> stencil =
+      CompileStencilWithDiskCache(cx, options, source);
+  if (!stencil) return nullptr;
+
+  insert(hash, filename, stencil);
+  return stencil.forget();
+}
+
+// Instantiate the (possibly cached) compiled script into the current global.
+JSScript* boilerplate::StencilCache::instantiate(
+    JSContext* cx, const JS::ReadOnlyCompileOptions& options,
+    JS::SourceText<mozilla::Utf8Unit>& source) {
+  RefPtr<JS::Stencil> stencil = getOrCompile(cx, options, source);
+  if (!stencil) return nullptr;
+
+  JS::InstantiateOptions instantiateOptions(options);
+  return JS::InstantiateGlobalStencil(cx, instantiateOptions, stencil);
+}
+
+// Like JS::Evaluate(), but only compiles the source the first time.
+bool boilerplate::StencilCache::evaluate(
+    JSContext* cx, const JS::ReadOnlyCompileOptions& options,
+    JS::SourceText<mozilla::Utf8Unit>& source, JS::MutableHandleValue rval) {
+  JS::RootedScript script(cx, instantiate(cx, options, source));
+  if (!script) return false;
+
+  return JS_ExecuteScript(cx, script, rval);
+}
+
+size_t boilerplate::StencilCache::size() {
+  std::lock_guard<std::mutex> guard(m_lock);
+  return m_entries.size();
+}
+
+void boilerplate::StencilCache::clear() {
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_index.clear();
+  m_entries.clear();
+}
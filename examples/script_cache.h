@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <jsapi.h>
+#include <js/CompileOptions.h>
+#include <js/SourceText.h>
+#include <js/experimental/JSStencil.h>
+#include <mozilla/RefPtr.h>
+
+// See 'script_cache.cpp' for documentation.
+
+namespace boilerplate {
+
+uint64_t HashScriptSource(const JS::ReadOnlyCompileOptions& options,
+                          const char* units, size_t length);
+
+already_AddRefed<JS::Stencil> CompileStencilWithDiskCache(
+    JSContext* cx, const JS::ReadOnlyCompileOptions& options,
+    JS::SourceText<mozilla::Utf8Unit>& source);
+
+bool EvaluateCached(JSContext* cx, const JS::ReadOnlyCompileOptions& options,
+                    JS::SourceText<mozilla::Utf8Unit>& source,
+                    JS::MutableHandleValue rval);
+
+class StencilCache {
+ public:
+  explicit StencilCache(size_t capacity) : m_capacity(capacity) {}
+
+  StencilCache(const StencilCache&) = delete;
+  StencilCache& operator=(const StencilCache&) = delete;
+
+  already_AddRefed<JS::Stencil> getOrCompile(
+      JSContext* cx, const JS::ReadOnlyCompileOptions& options,
+      JS::SourceText<mozilla::Utf8Unit>& source);
+
+  JSScript* instantiate(JSContext* cx,
+                        const JS::ReadOnlyCompileOptions& options,
+                        JS::SourceText<mozilla::Utf8Unit>& source);
+
+  bool evaluate(JSContext* cx, const JS::ReadOnlyCompileOptions& options,
+                JS::SourceText<mozilla::Utf8Unit>& source,
+                JS::MutableHandleValue rval);
+
+  size_t size();
+  void clear();
+
+ private:
+  struct Entry {
+    uint64_t hash;
+    std::string filename;
+    RefPtr<JS::Stencil> stencil;
+  };
+  using EntryList = std::list<Entry>;
+
+  already_AddRefed<JS::Stencil> lookup(uint64_t hash, const char* filename);
+  void insert(uint64_t hash, const char* filename, JS::Stencil* stencil);
+
+  size_t m_capacity;
+  std::mutex m_lock;
+  // Most recently used first.
+  EntryList m_entries;
+  std::unordered_multimap<uint64_t, EntryList::iterator> m_index;
+};
+
+}  // namespace boilerplate
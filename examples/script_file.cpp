@@ -0,0 +1,241 @@
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <sys/stat.h>
+
+#include <jsapi.h>
+#include <jsfriendapi.h>
+#include <js/CompilationAndEvaluation.h>
+#include <js/SourceText.h>
+#include <js/Utility.h>
+#include <mozilla/UniquePtr.h>
+
+#include "mapped_file.h"
+#include "script_file.h"
+
+// Loading scripts from files without copying them.
+//
+// Normally, SpiderMonkey keeps its own copy of the source text of every script
+// it compiles. It needs it for Function.prototype.toString(), and for compiling
+// the bodies of functions lazily, the first time they are called. For large
+// bundles, that copy costs both time when loading and memory for as long as the
+// script is alive.
+//
+// CompileFile() maps the file into memory and compiles it directly from the
+// mapping, which saves reading it into a buffer first. What happens to the
+// source text after that depends on the FileSource argument:
+//
+// - FileSource::Copy: SpiderMonkey copies the text, as it would from any
+//   buffer, and the mapping is dropped after compiling.
+// - FileSource::Mapped: SpiderMonkey is told not to keep the text
+//   (CompileOptions::setSourceIsLazy()). When it later needs it, it asks the
+//   embedding through a js::SourceHook, which copies it from the mapping again.
+//   The mapped pages are backed by the file, so they don't count against the
+//   process's memory in the way a heap copy does.
+//
+// The trade-off: SpiderMonkey only parses functions lazily if it has their
+// source at hand, so with FileSource::Mapped every function in the file is
+// fully compiled up front, including those that are never called. That costs
+// compile time and memory for bytecode, and only pays off for files whose
+// functions mostly do run, or when the source text is big compared to the
+// code. Measure both ('bench files') before choosing.
+//
+// The mappings are kept for the lifetime of the process, since any function
+// compiled from them might need its source later. The source hook only knows
+// the script's filename, so each path is mapped once: compiling the same path
+// again reuses the mapping if the file is unchanged, and otherwise falls back
+// to FileSource::Copy, so that the earlier scripts keep getting their own
+// text.
+//
+// NOTE: The files must not be modified in place while the scripts compiled
+// from them are alive; SpiderMonkey would get source text that doesn't match
+// the compiled code. Replacing a file (writing a new one and renaming it over
+// the old one) is fine.
+
+namespace {
+struct MappedSource {
+  boilerplate::MappedFile file;
+  // Identifies the version of the file that was mapped.
+  dev_t device;
+  ino_t inode;
+  off_t size;
+  time_t modified;
+
+  bool isFileOf(const struct stat& info) const {
+    return device == info.st_dev && inode == info.st_ino &&
+           size == info.st_size && modified == info.st_mtime;
+  }
+};
+}  // namespace
+
+static std::mutex mappedSourcesLock;
+static std::unordered_map<std::string, std::unique_ptr<MappedSource>>
+    mappedSources;
+
+// Mappings are never removed, so the result stays valid without the lock.
+static const MappedSource* FindMappedSource(const char* path) {
+  std::lock_guard<std::mutex> guard(mappedSourcesLock);
+  auto entry = mappedSources.find(path);
+  if (entry == mappedSources.end()) return nullptr;
+  return entry->second.get();
+}
+
+// Map the file at 'path', which 'info' describes, unless it is already mapped.
+// Returns null with an exception pending if it could not be mapped, and sets
+// '*isCurrent' to false if the path is already mapped to another version of
+// the file.
+static const MappedSource* MapSource(JSContext* cx, const char* path,
+                                     const struct stat& info,
+                                     bool* isCurrent) {
+  std::lock_guard<std::mutex> guard(mappedSourcesLock);
+  std::unique_ptr<MappedSource>& entry = mappedSources[path];
+  if (entry) {
+    *isCurrent = entry->isFileOf(info);
+    return entry.get();
+  }
+
+  auto source = std::make_unique<MappedSource>();
+  if (!source->file.map(path)) {
+    mappedSources.erase(path);
+    JS_ReportErrorUTF8(cx, "can't open %s: %s", path,
+                       strerror(source->file.error()));
+    return nullptr;
+  }
+  source->device = info.st_dev;
+  source->inode = info.st_ino;
+  source->size = info.st_size;
+  source->modified = info.st_mtime;
+
+  *isCurrent = true;
+  entry = std::move(source);
+  return entry.get();
+}
+
+// The source hooks installed by EnsureSourceHook(), so that it can recognize
+// them. A hook removes itself when SpiderMonkey destroys it with its runtime,
+// so a pointer in the set always refers to a live MappedSourceHook.
+static std::mutex sourceHooksLock;
+static std::unordered_set<js::SourceHook*> sourceHooks;
+
+class MappedSourceHook : public js::SourceHook {
+  // A hook that was installed before ours, for files that aren't ours.
+  mozilla::UniquePtr<js::SourceHook> m_next;
+
+ public:
+  explicit MappedSourceHook(mozilla::UniquePtr<js::SourceHook> next)
+      : m_next(std::move(next)) {
+    std::lock_guard<std::mutex> guard(sourceHooksLock);
+    sourceHooks.insert(this);
+  }
+
+  ~MappedSourceHook() override {
+    std::lock_guard<std::mutex> guard(sourceHooksLock);
+    sourceHooks.erase(this);
+  }
+
+  static bool Is(js::SourceHook* hook) {
+    std::lock_guard<std::mutex> guard(sourceHooksLock);
+    return sourceHooks.count(hook);
+  }
+
+  // js::SourceHook override
+  bool load(JSContext* cx, const char* filename, char16_t** twoByteSource,
+            char** utf8Source, size_t* length) override {
+    // We only compile UTF-8 files, so SpiderMonkey will only ask us for UTF-8.
+    const MappedSource* source = nullptr;
+    if (filename && utf8Source) source = FindMappedSource(filename);
+    if (!source) {
+      // Leaving the source null means that it is not available.
+      if (!m_next) return true;
+      return m_next->load(cx, filename, twoByteSource, utf8Source, length);
+    }
+
+    // SpiderMonkey takes ownership of the returned buffer, so it must be a
+    // copy, allocated with SpiderMonkey's allocator.
+    const boilerplate::MappedFile& file = source->file;
+    char* chars = js_pod_malloc<char>(file.size());
+    if (!chars) {
+      JS_ReportOutOfMemory(cx);
+      return false;
+    }
+    memcpy(chars, file.data(), file.size());
+
+    *utf8Source = chars;
+    *length = file.size();
+    return true;
+  }
+};
+
+// Install our source hook in the context's runtime, unless it is already
+// there. A hook that the embedding installed before is kept, and asked for
+// the source of scripts that didn't come from CompileFile().
+static void EnsureSourceHook(JSContext* cx) {
+  mozilla::UniquePtr<js::SourceHook> hook = js::ForgetSourceHook(cx);
+  if (!hook || !MappedSourceHook::Is(hook.get())) {
+    hook = mozilla::MakeUnique<MappedSourceHook>(std::move(hook));
+  }
+  js::SetSourceHook(cx, std::move(hook));
+}
+
+// Compile the UTF-8 file at 'path' as a global script, using the path as the
+// script's filename. See above for 'how'. Returns null with an exception
+// pending on failure.
+JSScript* boilerplate::CompileFile(JSContext* cx, const char* path,
+                                   FileSource how) {
+  JS::CompileOptions options(cx);
+  options.setFileAndLine(path, 1);
+
+  JS::SourceText<mozilla::Utf8Unit> source;
+
+  struct stat info;
+  if (stat(path, &info) != 0) {
+    JS_ReportErrorUTF8(cx, "can't open %s: %s", path, strerror(errno));
+    return nullptr;
+  }
+
+  // Empty files can't be mapped, but are valid (empty) scripts.
+  if (info.st_size == 0) {
+    if (!source.init(cx, "", 0, JS::SourceOwnership::Borrowed)) return nullptr;
+    return JS::Compile(cx, options, source);
+  }
+
+  MappedFile copied;
+  const MappedFile* file = &copied;
+  if (how == FileSource::Mapped) {
+    bool isCurrent;
+    const MappedSource* mapped = MapSource(cx, path, info, &isCurrent);
+    if (!mapped) return nullptr;
+
+    if (isCurrent) {
+      EnsureSourceHook(cx);
+      options.setSourceIsLazy(true);
+      file = &mapped->file;
+    }
+  }
+
+  if (file == &copied && !copied.map(path)) {
+    JS_ReportErrorUTF8(cx, "can't open %s: %s", path,
+                       strerror(copied.error()));
+    return nullptr;
+  }
+
+  if (!source.init(cx, reinterpret_cast<const char*>(file->data()),
+                   file->size(), JS::SourceOwnership::Borrowed)) {
+    return nullptr;
+  }
+  return JS::Compile(cx, options, source);
+}
+
+// Compile and run the file at 'path' in the current global.
+bool boilerplate::EvaluateFile(JSContext* cx, const char* path,
+                               JS::MutableHandleValue rval, FileSource how) {
+  JS::RootedScript script(cx, CompileFile(cx, path, how));
+  if (!script) return false;
+
+  return JS_ExecuteScript(cx, script, rval);
+}
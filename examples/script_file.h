@@ -0,0 +1,21 @@
+#pragma once
+
+#include <jsapi.h>
+
+// See 'script_file.cpp' for documentation.
+
+namespace boilerplate {
+
+// What SpiderMonkey keeps of the source text of a compiled file.
+enum class FileSource {
+  Copy,    // its own copy, as for any other script
+  Mapped,  // nothing; it is read back from the file's mapping when needed
+};
+
+JSScript* CompileFile(JSContext* cx, const char* path,
+                      FileSource how = FileSource::Copy);
+
+bool EvaluateFile(JSContext* cx, const char* path, JS::MutableHandleValue rval,
+                  FileSource how = FileSource::Copy);
+
+}  // namespace boilerplate
@@ -0,0 +1,107 @@
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
+#include <jsapi.h>
+#include <js/String.h>
+#include <mozilla/Maybe.h>
+#include <mozilla/Span.h>
+
+#include "string_bridge.h"
+
+// Helpers for natives that pass a lot of strings between C++ and JS, to avoid
+// allocating and copying on every call.
+//
+// From C++ to JS:
+//
+// - NewStaticString() wraps a string constant that lives as long as the
+//   process, such as a u"..." literal, in a JS string without copying it.
+//   SpiderMonkey calls these external strings. It also keeps a small cache of
+//   recently created external strings, so returning the same constant over and
+//   over often doesn't even allocate a new string.
+//
+// - InternString() returns an atom for a C string constant, and remembers it,
+//   so that later calls for the same constant are a hash table lookup with no
+//   allocation at all. The atoms are pinned, so this is for a bounded set of
+//   frequently returned values, not for arbitrary data. The cache is keyed on
+//   the address of the characters, so pass string literals or other constants.
+//
+// From JS to C++:
+//
+// - EncodeUTF8() converts a JS string to UTF-8 in a buffer that is reused for
+//   every call on the same thread, instead of JS_EncodeStringToUTF8()'s new
+//   allocation every time. The result is valid until the next call. A buffer
+//   that grew for an unusually long string is freed on the next call for a
+//   shorter one.
+//
+// Atoms belong to a runtime, and each thread has its own context and runtime,
+// so the caches are per thread. Call ResetStringCaches() before destroying the
+// thread's context.
+
+namespace {
+// External strings pointing into static storage: nothing to free.
+struct StaticStringCallbacks : public JSExternalStringCallbacks {
+  void finalize(char16_t* chars) const override {}
+  size_t sizeOfBuffer(const char16_t* chars,
+                      mozilla::MallocSizeOf mallocSizeOf) const override {
+    return 0;
+  }
+};
+}  // namespace
+
+static const StaticStringCallbacks staticStringCallbacks;
+
+JSString* boilerplate::NewStaticString(JSContext* cx, const char16_t* chars,
+                                       size_t length) {
+  // Very short strings are copied into the string itself, which is cheaper
+  // than creating an external string; this function takes care of choosing.
+  bool allocatedExternal;
+  return JS_NewMaybeExternalString(cx, chars, length, &staticStringCallbacks,
+                                   &allocatedExternal);
+}
+
+static thread_local std::unordered_map<const char*, JSString*> s_internCache;
+
+JSString* boilerplate::InternString(JSContext* cx, const char* chars) {
+  auto entry = s_internCache.find(chars);
+  if (entry != s_internCache.end()) return entry->second;
+
+  // Pinned atoms are never collected or moved, so the cache needs no tracing.
+  JSString* atom = JS_AtomizeAndPinString(cx, chars);
+  if (!atom) return nullptr;
+  s_internCache.emplace(chars, atom);
+  return atom;
+}
+
+static thread_local std::string s_encodeBuffer;
+
+// The most buffer to keep for the next call.
+static constexpr size_t MaxKeptEncodeBuffer = 64 * 1024;
+
+bool boilerplate::EncodeUTF8(JSContext* cx, JS::HandleString str,
+                             std::string_view* out) {
+  // Each UTF-16 code unit becomes at most 3 bytes of UTF-8.
+  size_t maxLength = JS_GetStringLength(str) * 3;
+  if (s_encodeBuffer.size() > MaxKeptEncodeBuffer &&
+      maxLength <= MaxKeptEncodeBuffer) {
+    std::string().swap(s_encodeBuffer);
+  }
+  if (s_encodeBuffer.size() < maxLength) s_encodeBuffer.resize(maxLength);
+
+  mozilla::Maybe<std::tuple<size_t, size_t>> result =
+      JS_EncodeStringToUTF8BufferPartial(
+          cx, str, mozilla::Span<char>(s_encodeBuffer.data(), maxLength));
+  // This only fails if the string could not be flattened, which has reported
+  // the error already.
+  if (!result) return false;
+
+  *out = std::string_view(s_encodeBuffer.data(), std::get<1>(*result));
+  return true;
+}
+
+// Forget the interned atoms of the context that is about to be destroyed, and
+// free the encoding buffer.
+void boilerplate::ResetStringCaches(JSContext* cx) {
+  s_internCache.clear();
+  std::string().swap(s_encodeBuffer);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+#include <jsapi.h>
+#include <js/RootingAPI.h>
+
+// See 'string_bridge.cpp' for documentation.
+
+namespace boilerplate {
+
+JSString* NewStaticString(JSContext* cx, const char16_t* chars, size_t length);
+
+template <size_t N>
+JSString* NewStaticString(JSContext* cx, const char16_t (&chars)[N]) {
+  return NewStaticString(cx, chars, N - 1);
+}
+
+JSString* InternString(JSContext* cx, const char* chars);
+
+bool EncodeUTF8(JSContext* cx, JS::HandleString str, std::string_view* out);
+
+void ResetStringCaches(JSContext* cx);
+
+}  // namespace boilerplate
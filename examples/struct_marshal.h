@@ -0,0 +1,215 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <utility>
+
+#include <jsapi.h>
+#include <js/CompilationAndEvaluation.h>
+#include <js/CompileOptions.h>
+#include <js/Id.h>
+#include <js/RootingAPI.h>
+#include <js/SourceText.h>
+#include <js/ValueArray.h>
+
+#include "native_binding.h"
+
+// Convert between C++ structs and plain JS objects, for embeddings that pass
+// many records of the same type to and from script. Declare the fields once:
+//
+//   struct Record {
+//     int32_t id;
+//     double score;
+//     std::string name;
+//   };
+//
+//   boilerplate::StructMarshaller records(
+//       boilerplate::Field("id", &Record::id),
+//       boilerplate::Field("score", &Record::score),
+//       boilerplate::Field("name", &Record::name));
+//   if (!records.init(cx)) return false;
+//
+// and then convert records with records.toJS(cx, record, &value) and
+// records.fromJS(cx, obj, &record).
+//
+// Building an object with JS_NewPlainObject() and one JS_SetProperty() per
+// field atomizes each name and moves the object through a new shape for each
+// property. Instead, init() compiles a small factory function that returns an
+// object literal with all the fields, like
+//
+//   function (f0, f1, f2) { return {"id": f0, "score": f1, "name": f2}; }
+//
+// and toJS() calls it. SpiderMonkey allocates object literals directly with
+// their final shape, which all the records then share. fromJS() reads the
+// fields with pre-atomized, pinned keys.
+//
+// Field names must be ASCII identifiers other than __proto__; init() fails
+// otherwise.
+//
+// Field types are the ones supported by 'native_binding.h': int32_t, uint32_t,
+// double, bool and std::string. Converting from JS follows the same rules as
+// for native arguments, so a missing property is converted from undefined.
+//
+// The factory function belongs to the realm that was current when init() was
+// called, and toJS() always creates objects in that realm. Called from another
+// realm, toJS() returns a cross-compartment wrapper if the realms are in
+// different compartments, so a marshaller is best used from the realm it was
+// initialized in. The marshaller holds a persistent root, so it must be
+// destroyed before its context.
+
+namespace boilerplate {
+
+template <typename S, typename T>
+struct Field {
+  const char* name;
+  T S::*member;
+
+  constexpr Field(const char* name_, T S::*member_)
+      : name(name_), member(member_) {}
+};
+
+template <typename S, typename... Ts>
+class StructMarshaller {
+ public:
+  static constexpr size_t FieldCount = sizeof...(Ts);
+
+  explicit StructMarshaller(Field<S, Ts>... fields) : m_fields(fields...) {}
+
+  StructMarshaller(const StructMarshaller&) = delete;
+  StructMarshaller& operator=(const StructMarshaller&) = delete;
+
+  bool init(JSContext* cx) {
+    std::string body = "return {";
+    std::array<std::string, FieldCount> argNames;
+    std::array<const char*, FieldCount> argNamePtrs;
+    bool ok = true;
+
+    size_t i = 0;
+    std::apply(
+        [&](const auto&... field) {
+          ((ok = ok && initField(cx, i, field.name, &body, &argNames[i],
+                                 &argNamePtrs[i]),
+            i++),
+           ...);
+        },
+        m_fields);
+    if (!ok) return false;
+    body += "};";
+
+    JS::CompileOptions options(cx);
+    options.setFileAndLine("struct_marshal", 1);
+
+    JS::SourceText<mozilla::Utf8Unit> source;
+    if (!source.init(cx, body.c_str(), body.length(),
+                     JS::SourceOwnership::Borrowed)) {
+      return false;
+    }
+
+    JS::RootedObjectVector emptyScopeChain(cx);
+    JSFunction* factory =
+        JS::CompileFunction(cx, emptyScopeChain, options, "make", FieldCount,
+                            argNamePtrs.data(), source);
+    if (!factory) return false;
+
+    m_factory.init(cx, factory);
+    return true;
+  }
+
+  // Create a JS object with the struct's fields, and wrap it for the current
+  // realm.
+  bool toJS(JSContext* cx, const S& value, JS::MutableHandleValue rval) {
+    {
+      JSAutoRealm ar(cx, JS_GetFunctionObject(m_factory));
+      JS::RootedValueArray<FieldCount> args(cx);
+      if (!setArgs(cx, value, &args, std::index_sequence_for<Ts...>{}) ||
+          !JS_CallFunction(cx, nullptr, m_factory, args, rval)) {
+        return false;
+      }
+    }
+    return JS_WrapValue(cx, rval);
+  }
+
+  // Read the struct's fields from a JS object.
+  bool fromJS(JSContext* cx, JS::HandleObject obj, S* out) {
+    return getFields(cx, obj, out, std::index_sequence_for<Ts...>{});
+  }
+
+ private:
+  // The names are spliced into source code, so only accept ASCII identifiers.
+  // In an object literal, "__proto__" would set the prototype instead of
+  // defining a property.
+  static bool IsValidFieldName(const char* name) {
+    auto isStart = [](char c) {
+      return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+             c == '$';
+    };
+    if (!isStart(name[0]) || strcmp(name, "__proto__") == 0) return false;
+    for (const char* c = name + 1; *c; c++) {
+      if (!isStart(*c) && !(*c >= '0' && *c <= '9')) return false;
+    }
+    return true;
+  }
+
+  bool initField(JSContext* cx, size_t i, const char* name, std::string* body,
+                 std::string* argName, const char** argNamePtr) {
+    if (!IsValidFieldName(name)) {
+      JS_ReportErrorASCII(cx, "invalid struct field name");
+      return false;
+    }
+
+    JSString* atom = JS_AtomizeAndPinString(cx, name);
+    if (!atom) return false;
+    m_ids[i] = JS::PropertyKey::fromPinnedString(atom);
+
+    *argName = "f" + std::to_string(i);
+    *argNamePtr = argName->c_str();
+
+    if (i > 0) *body += ", ";
+    *body += '"';
+    *body += name;
+    *body += "\": ";
+    *body += *argName;
+    return true;
+  }
+
+  template <size_t... I>
+  bool setArgs(JSContext* cx, const S& value,
+               JS::RootedValueArray<FieldCount>* args,
+               std::index_sequence<I...>) {
+    return (detail::ReturnConverter<Ts>::set(
+                cx, value.*(std::get<I>(m_fields).member), (*args)[I]) &&
+            ...);
+  }
+
+  template <size_t... I>
+  bool getFields(JSContext* cx, JS::HandleObject obj, S* out,
+                 std::index_sequence<I...>) {
+    JS::RootedValue v(cx);
+    return (getField<I, Ts>(cx, obj, &v, out) && ...);
+  }
+
+  template <size_t I, typename T>
+  bool getField(JSContext* cx, JS::HandleObject obj, JS::MutableHandleValue v,
+                S* out) {
+    if (!JS_GetPropertyById(
+            cx, obj, JS::HandleId::fromMarkedLocation(&m_ids[I]), v)) {
+      return false;
+    }
+
+    typename detail::ArgConverter<T>::Storage storage;
+    if (!detail::ArgConverter<T>::convert(cx, v, &storage)) return false;
+    out->*(std::get<I>(m_fields).member) =
+        detail::ArgConverter<T>::unwrap(storage);
+    return true;
+  }
+
+  std::tuple<Field<S, Ts>...> m_fields;
+  // Pinned atoms, which need no rooting.
+  std::array<JS::PropertyKey, FieldCount> m_ids;
+  JS::PersistentRooted<JSFunction*> m_factory;
+};
+
+}  // namespace boilerplate
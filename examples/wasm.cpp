@@ -7,6 +7,7 @@
 #include <js/ArrayBuffer.h>
 
 #include "boilerplate.h"
+#include "property_keys.h"
 
 // This example illustrates usage of WebAssembly JS API via embedded
 // SpiderMonkey. It does no error handling and simply exits if something
@@ -55,10 +56,17 @@ static bool WasmExample(JSContext* cx) {
   JS::RootedValue wasm(cx);
   JS::RootedValue wasmModule(cx);
   JS::RootedValue wasmInstance(cx);
-  if (!JS_GetProperty(cx, global, "WebAssembly", &wasm)) return false;
+  if (!boilerplate::InitPropertyKeys(cx)) return false;
+  if (!boilerplate::GetProperty(cx, global, boilerplate::Key::WebAssembly,
+                                &wasm))
+    return false;
   JS::RootedObject wasmObj(cx, &wasm.toObject());
-  if (!JS_GetProperty(cx, wasmObj, "Module", &wasmModule)) return false;
-  if (!JS_GetProperty(cx, wasmObj, "Instance", &wasmInstance)) return false;
+  if (!boilerplate::GetProperty(cx, wasmObj, boilerplate::Key::Module,
+                                &wasmModule))
+    return false;
+  if (!boilerplate::GetProperty(cx, wasmObj, boilerplate::Key::Instance,
+                                &wasmInstance))
+    return false;
 
 
   // Construct Wasm module from bytes.
@@ -83,7 +91,9 @@ static bool WasmExample(JSContext* cx) {
     // Build imports bag.
     JS::RootedObject imports(cx, JS_NewPlainObject(cx));
     if (!imports) return false;
-    if (!JS_SetProperty(cx, imports, "env", envImport)) return false;
+    if (!boilerplate::SetProperty(cx, imports, boilerplate::Key::env,
+                                  envImport))
+      return false;
 
     JS::RootedValueArray<2> args(cx);
     args[0].setObject(*module_.get()); // module
@@ -94,7 +104,9 @@ static bool WasmExample(JSContext* cx) {
 
   // Find `foo` method in exports.
   JS::RootedValue exports(cx);
-  if (!JS_GetProperty(cx, instance_, "exports", &exports)) return false;
+  if (!boilerplate::GetProperty(cx, instance_, boilerplate::Key::exports,
+                                &exports))
+    return false;
   JS::RootedObject exportsObj(cx, &exports.toObject());
   JS::RootedValue foo(cx);
   if (!JS_GetProperty(cx, exportsObj, "foo", &foo)) return false;
@@ -104,6 +116,8 @@ static bool WasmExample(JSContext* cx) {
     return false;
 
   printf("The answer is %d\n", rval.toInt32());
+
+  boilerplate::ResetPropertyKeys(cx);
   return true;
 }
 
@@ -0,0 +1,285 @@
+#include <algorithm>
+
+#if defined(__linux__) || defined(__FreeBSD__)
+#  include <pthread.h>
+#  include <time.h>
+#  define BOILERPLATE_HAVE_THREAD_CPU_CLOCK 1
+#endif
+
+#include <jsapi.h>
+
+#include "watchdog.h"
+
+// Execution budgets for scripts, so that one runaway script can't hold its
+// thread (and everything queued behind it) forever.
+//
+// SpiderMonkey checks for interrupt requests at loop headers and function
+// entries, and JS_RequestInterruptCallback() may be called from any thread.
+// The watchdog is a single thread shared by all contexts. When a budget runs
+// out, it requests an interrupt, and the context's interrupt callback then
+// either terminates the script, or, if the budget has an ExpiredCallback that
+// returns true, lets it continue for another budget (for example, after
+// yielding to other work queued on the same thread).
+//
+// Budgets are kept in a timing wheel: SlotCount lists of deadlines, one per
+// tick of the watchdog's resolution, each holding the deadlines that fall on
+// that tick modulo SlotCount. Starting and ending a budget are O(1) and take
+// the watchdog's lock only briefly; ended budgets are left in the wheel and
+// dropped when the watchdog reaches them. The thread sleeps while no budget is
+// running.
+//
+// Budgets are in CPU time where the thread's CPU clock can be read from the
+// watchdog thread (Linux and FreeBSD), so that time spent blocked, for example
+// in sleep(), doesn't count. The wall-clock deadline is only a lower bound
+// then; when it is reached, the watchdog checks the CPU time used and waits
+// for the remainder. Elsewhere, budgets are in wall-clock time.
+//
+// Terminating a script is like an uncatchable exception: the JSAPI call that
+// was running script returns false, with no exception pending.
+// AutoBudget::end() tells that apart from an ordinary error. Native functions
+// are not interrupted, so a long-running native call only stops when it
+// returns.
+//
+// Each context must be added with addContext() on its own thread before
+// starting budgets, and removed with removeContext() before the watchdog is
+// destroyed. There can only be one budget running per context at a time.
+
+struct boilerplate::Watchdog::ContextState {
+  Watchdog* watchdog;
+  JSContext* cx;
+
+  // Protected by the watchdog's lock.
+  uint64_t generation = 0;
+  bool armed = false;
+  Clock::duration budget{};
+  Clock::duration cpuStart{};
+#ifdef BOILERPLATE_HAVE_THREAD_CPU_CLOCK
+  clockid_t cpuClock;
+  bool hasCpuClock = false;
+#endif
+
+  // Set by the watchdog, cleared on the context's thread.
+  std::atomic<bool> expired{false};
+
+  // Only used on the context's thread.
+  ExpiredCallback onExpired;
+  bool terminated = false;
+};
+
+// The interrupt callback only gets the context, but there is only one context
+// per thread.
+static thread_local boilerplate::Watchdog::ContextState* watchdogState =
+    nullptr;
+
+static boilerplate::Watchdog::Clock::duration CpuTime(
+    const boilerplate::Watchdog::ContextState* state) {
+#ifdef BOILERPLATE_HAVE_THREAD_CPU_CLOCK
+  struct timespec ts;
+  if (state->hasCpuClock && clock_gettime(state->cpuClock, &ts) == 0) {
+    return std::chrono::duration_cast<boilerplate::Watchdog::Clock::duration>(
+        std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec));
+  }
+#endif
+  return {};
+}
+
+boilerplate::Watchdog::Watchdog(Clock::duration resolution)
+    : m_resolution(resolution),
+      m_start(Clock::now()),
+      m_currentTick(0),
+      m_armed(0),
+      m_idle(false),
+      m_shuttingDown(false),
+      m_thread(&Watchdog::watchdogMain, this) {}
+
+boilerplate::Watchdog::~Watchdog() {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_shuttingDown = true;
+  }
+  m_wakeup.notify_one();
+  m_thread.join();
+}
+
+boilerplate::Watchdog::ContextState* boilerplate::Watchdog::StateFor(
+    JSContext* cx) {
+  ContextState* state = watchdogState;
+  return state && state->cx == cx ? state : nullptr;
+}
+
+// Watch a context. Must be called on the context's thread.
+bool boilerplate::Watchdog::addContext(JSContext* cx) {
+  if (ContextState* state = StateFor(cx)) return state->watchdog == this;
+
+  // Interrupt callbacks can't be removed, so a context that is removed and
+  // added again gets ours twice. OnInterrupt() only acts on the first call.
+  if (!JS_AddInterruptCallback(cx, OnInterrupt)) return false;
+
+  auto state = std::make_unique<ContextState>();
+  state->watchdog = this;
+  state->cx = cx;
+#ifdef BOILERPLATE_HAVE_THREAD_CPU_CLOCK
+  state->hasCpuClock =
+      pthread_getcpuclockid(pthread_self(), &state->cpuClock) == 0;
+#endif
+
+  watchdogState = state.get();
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_contexts.push_back(std::move(state));
+  return true;
+}
+
+// Stop watching a context, ending any budget it has running. Must be called on
+// the context's thread, before the context or the watchdog is destroyed.
+void boilerplate::Watchdog::removeContext(JSContext* cx) {
+  ContextState* state = StateFor(cx);
+  if (!state || state->watchdog != this) return;
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (state->armed) m_armed--;
+  for (std::vector<Entry>& slot : m_slots) {
+    std::erase_if(slot, [state](const Entry& e) { return e.state == state; });
+  }
+  std::erase_if(m_contexts, [state](const std::unique_ptr<ContextState>& s) {
+    return s.get() == state;
+  });
+  watchdogState = nullptr;
+}
+
+// Start a budget for the script that the context runs next. Must be called on
+// the context's thread.
+void boilerplate::Watchdog::startBudget(JSContext* cx, Clock::duration budget,
+                                        ExpiredCallback onExpired) {
+  ContextState* state = StateFor(cx);
+  if (!state || state->watchdog != this) return;
+
+  state->onExpired = std::move(onExpired);
+  state->terminated = false;
+  m_stats.budgets.fetch_add(1, std::memory_order_relaxed);
+
+  bool wake;
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    // Otherwise the watchdog is already waiting for its next tick.
+    wake = m_idle;
+    if (!state->armed) m_armed++;
+
+    state->generation++;
+    state->armed = true;
+    state->expired = false;
+    state->budget = budget;
+    state->cpuStart = CpuTime(state);
+    schedule(state, budget);
+  }
+
+  if (wake) m_wakeup.notify_one();
+}
+
+// End the context's budget. Returns whether the script was terminated because
+// the budget ran out.
+bool boilerplate::Watchdog::endBudget(JSContext* cx) {
+  ContextState* state = StateFor(cx);
+  if (!state || state->watchdog != this) return false;
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (state->armed) {
+    m_armed--;
+    state->generation++;
+    state->armed = false;
+    state->expired = false;
+  }
+  return state->terminated;
+}
+
+// Called with the lock held.
+void boilerplate::Watchdog::schedule(ContextState* state,
+                                     Clock::duration delay) {
+  uint64_t now = uint64_t((Clock::now() - m_start) / m_resolution);
+  uint64_t ticks = uint64_t((delay + m_resolution - Clock::duration(1)) /
+                            m_resolution);
+  uint64_t deadline =
+      std::max(now, m_currentTick) + std::max(ticks, uint64_t(1));
+
+  m_slots[deadline % SlotCount].push_back(
+      {state, state->generation, deadline});
+}
+
+// Called with the lock held, when an entry's deadline has passed.
+void boilerplate::Watchdog::expire(const Entry& entry) {
+  ContextState* state = entry.state;
+
+#ifdef BOILERPLATE_HAVE_THREAD_CPU_CLOCK
+  if (state->hasCpuClock) {
+    Clock::duration used = CpuTime(state) - state->cpuStart;
+    if (used < state->budget) {
+      schedule(state, state->budget - used);
+      return;
+    }
+  }
+#endif
+
+  state->expired = true;
+  m_stats.expired.fetch_add(1, std::memory_order_relaxed);
+  JS_RequestInterruptCallback(state->cx);
+}
+
+void boilerplate::Watchdog::watchdogMain() {
+  std::unique_lock<std::mutex> lock(m_lock);
+
+  while (!m_shuttingDown) {
+    if (m_armed == 0) {
+      m_idle = true;
+      m_wakeup.wait(lock);
+      m_idle = false;
+      // Nothing was due while idle, so skip the ticks that passed.
+      m_currentTick = std::max(
+          m_currentTick, uint64_t((Clock::now() - m_start) / m_resolution));
+      continue;
+    }
+
+    uint64_t now = uint64_t((Clock::now() - m_start) / m_resolution);
+    while (m_currentTick < now) {
+      m_currentTick++;
+      std::vector<Entry>& slot = m_slots[m_currentTick % SlotCount];
+
+      for (size_t i = 0; i < slot.size();) {
+        Entry entry = slot[i];
+        bool current = entry.generation == entry.state->generation;
+        if (current && entry.deadlineTick > m_currentTick) {
+          i++;  // due in a later turn of the wheel
+          continue;
+        }
+
+        slot[i] = slot.back();
+        slot.pop_back();
+        if (current) expire(entry);
+      }
+    }
+
+    m_wakeup.wait_until(lock, m_start + (m_currentTick + 1) * m_resolution);
+  }
+}
+
+// Clearing 'expired' makes any other copies of the callback on the context do
+// nothing for the same interrupt.
+bool boilerplate::Watchdog::OnInterrupt(JSContext* cx) {
+  ContextState* state = StateFor(cx);
+  if (!state || !state->expired.exchange(false)) return true;
+
+  Watchdog* watchdog = state->watchdog;
+  if (state->onExpired && state->onExpired(cx)) {
+    watchdog->m_stats.extended.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> guard(watchdog->m_lock);
+    if (state->armed) {
+      state->generation++;
+      state->cpuStart = CpuTime(state);
+      watchdog->schedule(state, state->budget);
+    }
+    return true;
+  }
+
+  watchdog->m_stats.terminated.fetch_add(1, std::memory_order_relaxed);
+  state->terminated = true;
+  return false;
+}
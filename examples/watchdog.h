@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <jsapi.h>
+
+// See 'watchdog.cpp' for documentation.
+
+namespace boilerplate {
+
+class Watchdog {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // Called on the context's thread when its budget runs out. Return true to
+  // let the script continue for another budget, or false to terminate it.
+  using ExpiredCallback = std::function<bool(JSContext* cx)>;
+
+  struct Stats {
+    std::atomic<uint64_t> budgets{0};
+    std::atomic<uint64_t> expired{0};
+    std::atomic<uint64_t> extended{0};
+    std::atomic<uint64_t> terminated{0};
+  };
+
+  explicit Watchdog(
+      Clock::duration resolution = std::chrono::milliseconds(1));
+  ~Watchdog();
+
+  Watchdog(const Watchdog&) = delete;
+  Watchdog& operator=(const Watchdog&) = delete;
+
+  bool addContext(JSContext* cx);
+  void removeContext(JSContext* cx);
+
+  void startBudget(JSContext* cx, Clock::duration budget,
+                   ExpiredCallback onExpired = nullptr);
+  bool endBudget(JSContext* cx);
+
+  const Stats& stats() const { return m_stats; }
+
+  // Per-context state, defined in 'watchdog.cpp'.
+  struct ContextState;
+
+ private:
+  struct Entry {
+    ContextState* state;
+    uint64_t generation;
+    uint64_t deadlineTick;
+  };
+
+  static constexpr size_t SlotCount = 256;
+
+  static bool OnInterrupt(JSContext* cx);
+  static ContextState* StateFor(JSContext* cx);
+
+  void schedule(ContextState* state, Clock::duration delay);
+  void expire(const Entry& entry);
+  void watchdogMain();
+
+  Clock::duration m_resolution;
+  Clock::time_point m_start;
+  Stats m_stats;
+
+  std::mutex m_lock;
+  std::condition_variable m_wakeup;
+  std::array<std::vector<Entry>, SlotCount> m_slots;
+  std::vector<std::unique_ptr<ContextState>> m_contexts;
+  uint64_t m_currentTick;
+  size_t m_armed;
+  bool m_idle;
+  bool m_shuttingDown;
+
+  std::thread m_thread;
+};
+
+// Run script under a budget for the duration of a scope.
+class AutoBudget {
+ public:
+  AutoBudget(Watchdog& watchdog, JSContext* cx,
+             Watchdog::Clock::duration budget,
+             Watchdog::ExpiredCallback onExpired = nullptr)
+      : m_watchdog(watchdog), m_cx(cx) {
+    m_watchdog.startBudget(cx, budget, std::move(onExpired));
+  }
+  ~AutoBudget() { end(); }
+
+  AutoBudget(const AutoBudget&) = delete;
+  AutoBudget& operator=(const AutoBudget&) = delete;
+
+  // End the budget early. Returns whether the script was terminated.
+  bool end() {
+    if (m_cx) {
+      m_terminated = m_watchdog.endBudget(m_cx);
+      m_cx = nullptr;
+    }
+    return m_terminated;
+  }
+
+ private:
+  Watchdog& m_watchdog;
+  JSContext* m_cx;
+  bool m_terminated = false;
+};
+
+}  // namespace boilerplate
@@ -10,6 +10,7 @@
 #include <mozilla/Unused.h>
 
 #include "boilerplate.h"
+#include "script_cache.h"
 
 // This example illustrates what you have to do in your embedding to make
 // WeakRef and FinalizationRegistry work. Without notifying SpiderMonkey when to
@@ -232,7 +233,7 @@ static bool ExecuteCode(JSContext* cx, const char* code) {
   }
 
   JS::Rooted<JS::Value> rval{cx};
-  return JS::Evaluate(cx, options, source, &rval);
+  return boilerplate::EvaluateCached(cx, options, source, &rval);
 }
 
 static bool WeakRefExample(JSContext* cx) {
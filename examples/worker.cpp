@@ -1,15 +1,19 @@
 #include <cstdio>
 #include <cstdint>
 #include <chrono>
+#include <functional>
+#include <string_view>
 #include <thread>
 
 #include <jsapi.h>
 #include <js/CompilationAndEvaluation.h>
-#include <js/Conversions.h>
 #include <js/Initialization.h>
 #include <js/SourceText.h>
 
 #include "boilerplate.h"
+#include "native_binding.h"
+#include "script_cache.h"
+#include "watchdog.h"
 
 // This example illustrates usage of SpiderMonkey in multiple threads. It does
 // no error handling and simply exits if something goes wrong.
@@ -20,6 +24,10 @@
 // To use SpiderMonkey API in multiple threads, you need to create a JSContext
 // in the thread, using the main thread's JSRuntime as a parent, and initialize
 // self-hosted code, and create its own global.
+//
+// The worker threads run their scripts under a CPU time budget enforced by a
+// watchdog thread shared by all of them (see 'watchdog.cpp'), so that a script
+// stuck in a loop can't keep its thread busy forever.
 
 static bool ExecuteCode(JSContext* cx, const char* code) {
   JS::CompileOptions options(cx);
@@ -31,88 +39,101 @@ static bool ExecuteCode(JSContext* cx, const char* code) {
   }
 
   JS::Rooted<JS::Value> rval(cx);
-  if (!JS::Evaluate(cx, options, source, &rval)) {
+  if (!boilerplate::EvaluateCached(cx, options, source, &rval)) {
     return false;
   }
 
   return true;
 }
 
-static bool Print(JSContext* cx, unsigned argc, JS::Value* vp) {
-  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
-
-  JS::Rooted<JS::Value> arg(cx, args.get(0));
-  JS::Rooted<JSString*> str(cx, JS::ToString(cx, arg));
-  if (!str) {
-    return false;
-  }
-
-  JS::UniqueChars chars = JS_EncodeStringToUTF8(cx, str);
-  fprintf(stderr, "%s\n", chars.get());
-
-  args.rval().setUndefined();
-  return true;
+// These are plain C++ functions; see 'native_binding.h' for how the arguments
+// are converted from JS values.
+static void Print(std::string_view message) {
+  fprintf(stderr, "%.*s\n", int(message.length()), message.data());
 }
 
-static bool Sleep(JSContext* cx, unsigned argc, JS::Value* vp) {
-  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
-
-  JS::Rooted<JS::Value> arg(cx, args.get(0));
-  int32_t ms;
-  if (!JS::ToInt32(cx, arg, &ms)) {
-    return false;
-  }
-
+static void Sleep(int32_t ms) {
   std::this_thread::sleep_for(std::chrono::milliseconds(ms));
-
-  args.rval().setUndefined();
-  return true;
 }
 
 bool DefineFunctions(JSContext* cx, JS::Handle<JSObject*> global) {
-  if (!JS_DefineFunction(cx, global, "print", &Print, 0, 0)) {
+  if (!JS_DefineFunction(cx, global, "print",
+                         boilerplate::NativeFunction<Print>, 0, 0)) {
     return false;
   }
-  if (!JS_DefineFunction(cx, global, "sleep", &Sleep, 0, 0)) {
+  if (!JS_DefineFunction(cx, global, "sleep",
+                         boilerplate::NativeFunction<Sleep>, 0, 0)) {
     return false;
   }
 
   return true;
 }
 
-static void WorkerMain(JSRuntime* parentRuntime) {
-  JSContext* cx = JS_NewContext(8L * 1024L * 1024L, parentRuntime);
-
-  if (!JS::InitSelfHostedCode(cx)) {
-    fprintf(stderr, "Error: Failed during JS::InitSelfHostedCode\n");
+// Runs on the worker thread, with the context watched by the watchdog.
+static void RunWorkerScripts(JSContext* cx, boilerplate::Watchdog& watchdog) {
+  JS::Rooted<JSObject*> global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) {
+    fprintf(stderr, "Error: Failed during boilerplate::CreateGlobal\n");
     return;
   }
 
-  {
-    JS::Rooted<JSObject*> global(cx, boilerplate::CreateGlobal(cx));
-    if (!global) {
-      fprintf(stderr, "Error: Failed during boilerplate::CreateGlobal\n");
-      return;
-    }
-
-    JSAutoRealm ar(cx, global);
+  JSAutoRealm ar(cx, global);
 
-    if (!DefineFunctions(cx, global)) {
-      boilerplate::ReportAndClearException(cx);
-      return;
-    }
+  if (!DefineFunctions(cx, global)) {
+    boilerplate::ReportAndClearException(cx);
+    return;
+  }
 
-    if (!ExecuteCode(cx, R"js(
+  // This takes ten seconds, but almost all of it is spent in sleep(), which
+  // doesn't count towards the budget.
+  boilerplate::AutoBudget budget(watchdog, cx, std::chrono::seconds(1));
+  if (!ExecuteCode(cx, R"js(
 for (let i = 0; i < 10; i++) {
   print(`in worker thread, it is ${new Date()}`);
   sleep(1000);
 }
-    )js")) {
+  )js")) {
+    boilerplate::ReportAndClearException(cx);
+    return;
+  }
+  budget.end();
+
+  // This one never finishes on its own.
+  boilerplate::AutoBudget runawayBudget(watchdog, cx,
+                                        std::chrono::milliseconds(100));
+  if (!ExecuteCode(cx, "for (;;) {}")) {
+    if (runawayBudget.end()) {
+      fprintf(stderr, "worker script ran out of time and was stopped\n");
+    } else {
       boilerplate::ReportAndClearException(cx);
       return;
     }
   }
+}
+
+static void WorkerMain(JSRuntime* parentRuntime,
+                       const boilerplate::RuntimeConfig& config,
+                       boilerplate::Watchdog& watchdog) {
+  // Worker contexts get a smaller heap by default, unless configured otherwise.
+  JSContext* cx = config.newContext(parentRuntime, 8L * 1024L * 1024L);
+  if (!cx) {
+    fprintf(stderr, "Error: Failed during JS_NewContext\n");
+    return;
+  }
 
+  if (!JS::InitSelfHostedCode(cx)) {
+    fprintf(stderr, "Error: Failed during JS::InitSelfHostedCode\n");
+    return;
+  }
+
+  if (!watchdog.addContext(cx)) {
+    fprintf(stderr, "Error: Failed during Watchdog::addContext\n");
+    return;
+  }
+
+  RunWorkerScripts(cx, watchdog);
+
+  watchdog.removeContext(cx);
   JS_DestroyContext(cx);
 
   return;
@@ -124,8 +145,18 @@ static bool WorkerExample(JSContext* cx) {
     return false;
   }
 
-  std::thread thread1(WorkerMain, JS_GetRuntime(cx));
-  std::thread thread2(WorkerMain, JS_GetRuntime(cx));
+  // Use the same runtime settings as the main thread's context.
+  boilerplate::RuntimeConfig config;
+  if (!config.loadEnvironment()) {
+    return false;
+  }
+
+  boilerplate::Watchdog watchdog;
+
+  std::thread thread1(WorkerMain, JS_GetRuntime(cx), std::cref(config),
+                      std::ref(watchdog));
+  std::thread thread2(WorkerMain, JS_GetRuntime(cx), std::cref(config),
+                      std::ref(watchdog));
 
   JSAutoRealm ar(cx, global);
 